@@ -0,0 +1,82 @@
+/**
+ * @file array.h
+ * @brief array that either owns its elements or views external memory
+ *
+ */
+
+#ifndef ARRAY_H_
+#define ARRAY_H_
+
+#include "common.h"
+
+/*
+ * The subset of std::vector used by Graph. An array that views external
+ * memory (a mapped snapshot file, see Graph::LoadSnapshot) is read-only, and
+ * resizing it makes it an owning array again.
+ */
+template <typename T>
+class Array {
+ public:
+  Array() : data_(nullptr), size_(0) {}
+  Array(const Array &other) { *this = other; }
+  Array &operator=(const Array &other) {
+    if (this == &other) return *this;
+    owned_ = other.owned_;
+    if (other.IsView()) {
+      data_ = other.data_;
+      size_ = other.size_;
+    } else {
+      Own();
+    }
+    return *this;
+  }
+
+  void resize(size_t size) {
+    Adopt();
+    owned_.resize(size);
+    Own();
+  }
+  void assign(size_t size, const T &value) {
+    owned_.assign(size, value);
+    Own();
+  }
+  template <typename Iterator>
+  void assign(Iterator first, Iterator last) {
+    owned_.assign(first, last);
+    Own();
+  }
+  /*views size elements at data, which must outlive the array*/
+  void View(const T *data, size_t size) {
+    std::vector<T>().swap(owned_);
+    data_ = const_cast<T *>(data);
+    size_ = size;
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  T *data() { return data_; }
+  const T *data() const { return data_; }
+  T *begin() { return data_; }
+  const T *begin() const { return data_; }
+  T *end() { return data_ + size_; }
+  const T *end() const { return data_ + size_; }
+  T &operator[](size_t i) { return data_[i]; }
+  const T &operator[](size_t i) const { return data_[i]; }
+
+ private:
+  bool IsView() const { return data_ != nullptr && data_ != owned_.data(); }
+  /*copies viewed elements into owned storage before it is modified*/
+  void Adopt() {
+    if (IsView()) owned_.assign(data_, data_ + size_);
+  }
+  void Own() {
+    data_ = owned_.data();
+    size_ = owned_.size();
+  }
+
+  std::vector<T> owned_;
+  T *data_;
+  size_t size_;
+};
+
+#endif  // ARRAY_H_
@@ -6,47 +6,257 @@
 #ifndef BACKTRACK_H_
 #define BACKTRACK_H_
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+
 #include "candidate_set.h"
+#include "candidate_space.h"
 #include "common.h"
 #include "graph.h"
 #include "dag.h"
+#include "embedding_writer.h"
+#include "matching_order.h"
+#include "search_stats.h"
+#include "vertex_set.h"
+#include "work_stealing_pool.h"
 using namespace std;
 
+/*what main/program and the server do with the embeddings of a query*/
+enum MatchMode { kPrintMatches, kCountMatches, kExistsMatch };
+
+bool ParseMatchMode(const std::string &name, MatchMode &mode);
+
 class Backtrack {
  public:
-  Backtrack(const Graph &d, const Dag &q, const CandidateSet &c);
+  /*called with every embedding found (embedding[u] for every query vertex u); returning false stops the search.
+  calls are serialized when several workers search*/
+  using MatchCallback = function<bool(const Vertex *embedding, size_t size)>;
+  static const size_t kNoLimit = SIZE_MAX;
+  static const size_t kDefaultLimit = 100000;
+
+  Backtrack(const Graph &d, const Dag &q, const CandidateSet &c, size_t num_threads = 1, EmbeddingWriter *out = nullptr, OrderType order_type = kCandidateSizeOrder);
   ~Backtrack();
 
-  void PrintAllMatches();
+  void PrintAllMatches(size_t limit = kDefaultLimit);
+  size_t CountMatches(size_t limit = kNoLimit);
+  bool HasMatch();
+  size_t EnumerateMatches(const MatchCallback &callback, size_t limit = kNoLimit);
+  size_t GetNumEmbeddings() const;
+
+  void SetVerification(bool verify);
+  size_t GetNumInvalidEmbeddings() const;
+
+  void SetProgressInterval(double seconds);
+  const SearchStats &GetStats() const;
+
+  void SetSymmetryBreaking(bool enable);
+
+  void SetTimeLimit(double seconds);
+  void Cancel();
+  bool IsTruncated() const;
+  size_t GetNumRootCandidatesStarted() const;
+  size_t GetNumRootCandidates() const;
+
+  void SetCheckpoint(const string &filename, double interval_seconds);
+  void RequestCheckpoint();
+  bool ResumeFrom(const string &filename);
 
  private:
- void backtrack(Vertex curr);
- bool check_candidate(Vertex curr, Vertex curr_cs, const vector<Vertex> &curr_parent);
- void printembedding();
- void update_extendable(Vertex curr);
- bool check_replica();
+ /*search state of one worker, so that workers never share a partial embedding*/
+ struct SearchState {
+   /*partial embedding, embedding[u] = v, u: vertex of query, v: vertex of data
+   embedding[u] = -1 if mapping for u is not included yet*/
+   vector<Vertex> embedding;
+   /*embedding_index[u]: index of embedding[u] in the candidate set of u*/
+   vector<uint32_t> embedding_index;
+   /*reverse of embedding, mapped_by[v] = u for every data vertex v (-1 if v is not used),
+   so that injectivity is checked in constant time*/
+   vector<Vertex> mapped_by;
+   size_t embedding_size; /*# of vertices in partial embedding*/
+
+   /*extendable candidates of every vertex in one buffer, as indices in its candidate set:
+   those of u are the first extendable_size[u] entries from cs.GetCandidateId(u, 0)*/
+   vector<uint32_t> extendable;
+   vector<uint32_t> extendable_size;
+   /*is_extendable[u] is true if every parent of u is mapped, even if u has no extendable candidate*/
+   vector<bool> is_extendable;
+   /*extendable vertices that are not mapped, by their key in the matching order*/
+   VertexHeap heap;
+   vector<double> key; /*key[u]: key of u while it is extendable*/
+
+   /*undo log of the vertices that became extendable, so that unmapping only resets them.
+   undo_mark[d]: size of the log before the d-th mapping*/
+   vector<Vertex> undo_log;
+   vector<size_t> undo_mark;
+
+   /*(query vertex, candidate index) in the order they were mapped*/
+   vector<pair<Vertex, uint32_t>> mapped;
+
+   /*failing_sets[d]: failing set of the search node of the d-th frame, so that no set is allocated during the search*/
+   vector<VertexSet> failing_sets;
+
+   /*usable candidates of the leaves of one label while they are counted:
+   those of the k-th leaf of the group are [leaf_offset[k], leaf_offset[k+1])*/
+   vector<Vertex> leaf_candidates;
+   vector<size_t> leaf_offset;
 
- int check(); /*check if embedding is correct*/
+   /*candidate loops currently running, from the shallowest one: the explicit stack of the search,
+   whose untried candidates can also be handed to an idle worker*/
+   struct Frame {
+     Vertex curr;
+     const uint32_t *candidates;
+     size_t size;       /*# of candidates left to this loop*/
+     size_t next_index; /*index of the first untried candidate*/
+     size_t depth;      /*# of mapped vertices before curr*/
+     bool donated;      /*true if some candidates were handed to another worker*/
+     bool found;        /*true if the subtree of some candidate has an empty failing set*/
+     bool descended;    /*true while the candidate tried last is mapped and the frame above it runs*/
+   };
+   vector<Frame> frames;
 
- size_t cnt; /*# of embedding got*/
+   SearchStats stats; /*counts of this worker, see search_stats.h*/
+   size_t nodes_until_check; /*# of search nodes until the worker looks at the clock*/
+ };
+
+ void search(const MatchCallback *callback, size_t limit);
+ void init_state(SearchState &st);
+ void run_task(SearchState &st, size_t worker, SearchTask &task);
+ void split(SearchState &st, size_t worker);
+ void map_vertex(SearchState &st, Vertex u, uint32_t index);
+ void unmap_vertex(SearchState &st, Vertex u);
+
+ void backtrack(SearchState &st, size_t worker, Vertex curr, const uint32_t *curr_candidates, size_t curr_size);
+ void push_frame(SearchState &st, Vertex curr, const uint32_t *curr_candidates, size_t curr_size);
+ void pop_frame(SearchState &st);
+ bool merge_failing_set(SearchState &st, size_t frame_id);
+ Vertex next_vertex(const SearchState &st);
+ bool verified(const SearchState &st, size_t n);
+ void report_embedding(const SearchState &st, size_t n);
+ void set_up_symmetry();
+ void next_symmetric(vector<Vertex> &embedding);
+ inline Vertex symmetry_conflict(const SearchState &st, Vertex u, Vertex v) const;
+ void note_embedding(SearchState &st);
+ void print_progress();
+ void check_clock(SearchState &st);
+ void run_frames(SearchState &st, size_t worker, size_t base);
+ bool save_checkpoint(const SearchState &st);
+ bool restore_checkpoint(SearchState &st, const uint32_t *root_candidates, size_t root_size);
+ void update_extendable(SearchState &st, Vertex curr);
+ inline uint32_t *extendable_of(SearchState &st, Vertex u) const;
+ size_t count_leaves(SearchState &st, VertexSet &failing_set);
+ size_t count_leaf_group(SearchState &st, const Vertex *group, size_t k, size_t n);
+ size_t add_count(size_t n);
+ bool check_replica(const SearchState &st);
+ inline bool stopped() const;
+
+ /*outcome of check, by the condition the embedding violates*/
+ enum CheckResult { kCorrect = 0, kNotInjective = 1, kWrongLabel = 2, kMissingEdge = 3 };
+ CheckResult check(const SearchState &st); /*check if embedding is correct*/
+
+ atomic<size_t> cnt; /*# of embedding got, shared by all workers*/
+ size_t limit;        /*the search stops once cnt reaches it*/
+ const MatchCallback *callback; /*nullptr if embeddings are only counted*/
+ atomic<bool> halted; /*true if the callback stopped the search*/
+ atomic<bool> cancelled; /*true if the search was cancelled or ran out of time*/
+ atomic<bool> cancel_requested; /*set by Cancel and never cleared, so that a Cancel before the search is kept*/
+ double time_limit;      /*seconds a search may take, 0 for no limit*/
+ chrono::steady_clock::time_point deadline;
+ /*workers look at the clock once in this many search nodes, if there is a time limit or a checkpoint file*/
+ static const size_t kClockCheckInterval = 1024;
+ bool watch_clock;
+
+ string checkpoint_file;     /*where the frontier of the search is written, empty for none*/
+ double checkpoint_interval; /*seconds between checkpoints, 0 for only when requested or out of time*/
+ chrono::steady_clock::time_point next_checkpoint;
+ atomic<bool> checkpoint_requested; /*set by RequestCheckpoint, possibly from a signal handler*/
+
+ /*frontier of a search read by ResumeFrom: the frames of the stack of the worker from the root,
+ where every frame but the last one has its candidate at next_index-1 mapped*/
+ struct SavedFrame {
+   Vertex curr;
+   uint32_t mapped_index; /*candidate of curr that is mapped, unused for the last frame*/
+   size_t size;
+   size_t next_index;
+   bool found;
+   vector<Vertex> failing_set;
+ };
+ struct Checkpoint {
+   bool enumerate;       /*true if the embeddings were enumerated, false if counted*/
+   bool symmetry;        /*true if the search broke symmetries*/
+   size_t count;         /*# of embeddings found before the checkpoint*/
+   size_t roots_started;
+   vector<SavedFrame> frames; /*empty unless the next search resumes*/
+ };
+ Checkpoint resume;
+ bool verify;          /*check every embedding before it is reported*/
+
+ bool symmetry;        /*see SetSymmetryBreaking*/
+ /*classes of equivalent query vertices ordered by the search, each one sorted*/
+ vector<vector<Vertex>> classes;
+ /*equivalent[u]: the other vertices of the ordered class of u, empty if u is in none*/
+ vector<vector<Vertex>> equivalent;
+ size_t symmetry_factor; /*# of embeddings every embedding found stands for, the product of the factorials of the class sizes*/
+ vector<Vertex> expanded; /*symmetric image being reported*/
+ vector<Vertex> permuted; /*data vertices of one class being permuted*/
+ size_t num_invalid;   /*# of embeddings that failed the check, written under print_lock*/
 
-/*partial embedding, embedding[u] = v, u: vertex of query, v: vertex of data
-embedding[u] = -1 if mapping for u is not included yet*/
- vector<Vertex> embedding; 
  vector<vector<Vertex>> embedding_list;
 
- size_t embedding_size; /*# of vertices in partial embedding*/
  size_t q_size; /*# of vertices of query graph*/
 
- /*array of extendable vertices: <size of extendable candidates(0 if not extendable), array of extendable candidates>*/
- vector<pair<size_t,vector<Vertex>>> extendable;
-
  const Graph &data;
  const Dag &query;
  const CandidateSet &cs;
+ CandidateSpace space; /*candidates of each DAG edge, so that extendable candidates are intersections*/
+ MatchingOrder order;  /*chooses the next vertex among the extendable ones*/
 
  Vertex root; /*root of query DAG*/
 
+ /*leaves: query vertices of degree 1 other than the root. their candidates only depend on their parent,
+ so when embeddings are only counted they are mapped last, all at once, by counting*/
+ vector<bool> is_leaf;
+ vector<Vertex> leaves; /*sorted by label, as only leaves of the same label can share a candidate*/
+ bool postpone_leaves;  /*true while a search counts the leaves instead of mapping them*/
+
+ size_t num_threads;
+ WorkStealingPool *pool; /*nullptr unless a multi-threaded search is running*/
+ mutex print_lock;       /*serializes output of the workers*/
+ vector<Vertex> reported; /*embedding being reported, in the ids of the data graph file*/
+ vector<Vertex> checked;  /*embedding being verified, sorted*/
+
+ SearchStats stats;        /*merged counts of the workers of the last search*/
+ chrono::steady_clock::time_point search_start;
+ double progress_interval; /*seconds between progress lines on stderr, 0 for none*/
+ atomic<size_t> roots_started; /*# of root candidates whose subtree has been entered*/
+ EmbeddingWriter *out;   /*where embeddings are printed, text on stdout by default*/
+ unique_ptr<EmbeddingWriter> stdout_writer;
 };
 
+/*true when the embedding limit is reached, the callback asked to stop, or the search was cancelled,
+and every worker should return*/
+inline bool Backtrack::stopped() const {
+  return cnt.load(memory_order_relaxed) >= limit || halted.load(memory_order_relaxed) ||
+         cancelled.load(memory_order_relaxed);
+}
+
+/*an equivalent vertex of u whose mapping is on the wrong side of v: the vertices of a class are mapped in
+increasing order. -1 if there is none*/
+inline Vertex Backtrack::symmetry_conflict(const SearchState &st, Vertex u, Vertex v) const {
+  for(Vertex w: equivalent[u]){
+    Vertex mapped = st.embedding[w];
+    if(mapped!=-1&&(w<u)!=(mapped<v)) return w;
+  }
+  return -1;
+}
+
+/*extendable candidates of u in the buffer of st*/
+inline uint32_t *Backtrack::extendable_of(SearchState &st, Vertex u) const {
+  return st.extendable.data() + cs.GetCandidateId(u, 0);
+}
+
 #endif  // BACKTRACK_H_
@@ -8,18 +8,50 @@
 
 #include "common.h"
 
+class Graph;
+class Dag;
+
 class CandidateSet {
  public:
-  explicit CandidateSet(const std::string& filename);
+  explicit CandidateSet(const std::string& filename,
+                        const Graph *data = nullptr);
+  CandidateSet(const Graph &data, const Graph &query);
   ~CandidateSet();
 
+  void Refine(const Graph &data, const Dag &query, int max_passes = 16);
+
+  inline size_t GetNumQueryVertices() const;
+  inline size_t GetNumCandidates() const;
   inline size_t GetCandidateSize(Vertex u) const;
   inline Vertex GetCandidate(Vertex u, size_t i) const;
+  inline const Vertex *GetCandidates(Vertex u) const;
+  inline size_t GetCandidateId(Vertex u, size_t i) const;
 
  private:
-  std::vector<std::vector<Vertex>> cs_;
+  // candidates of every query vertex in one array, in ascending order of
+  // query vertex id: those of u are in [offset_[u], offset_[u + 1])
+  std::vector<Vertex> candidates_;
+  std::vector<size_t> offset_;
 };
 
+/**
+ * @brief Returns the number of query vertices the candidate set is for.
+ *
+ * @return size_t
+ */
+inline size_t CandidateSet::GetNumQueryVertices() const {
+  return offset_.size() - 1;
+}
+
+/**
+ * @brief Returns the total number of candidates of all query vertices.
+ *
+ * @return size_t
+ */
+inline size_t CandidateSet::GetNumCandidates() const {
+  return candidates_.size();
+}
+
 /**
  * @brief Returns the number of data vertices that may be mapped to query vertex
  * u.
@@ -28,17 +60,40 @@ class CandidateSet {
  * @return size_t
  */
 inline size_t CandidateSet::GetCandidateSize(Vertex u) const {
-  return cs_[u].size();
+  return offset_[u + 1] - offset_[u];
 }
 /**
  * @brief Returns the i-th candidate from query vertex u's candidate set.
+ * Candidates are sorted in ascending order of id.
  *
  * @param u query vertex id.
  * @param i index in half-open interval [0, GetCandidateSetSize(u)).
  * @return Vertex
  */
 inline Vertex CandidateSet::GetCandidate(Vertex u, size_t i) const {
-  return cs_[u][i];
+  return candidates_[offset_[u] + i];
+}
+/**
+ * @brief Returns the candidate set of query vertex u as an array of
+ * GetCandidateSize(u) data vertices, sorted in ascending order of id.
+ *
+ * @param u query vertex id.
+ * @return const Vertex*
+ */
+inline const Vertex *CandidateSet::GetCandidates(Vertex u) const {
+  return candidates_.data() + offset_[u];
+}
+/**
+ * @brief Returns the id of the i-th candidate of query vertex u among all
+ * candidates, in half-open interval [0, GetNumCandidates()), so that data
+ * attached to candidates can be kept in flat arrays.
+ *
+ * @param u query vertex id.
+ * @param i index in half-open interval [0, GetCandidateSetSize(u)).
+ * @return size_t
+ */
+inline size_t CandidateSet::GetCandidateId(Vertex u, size_t i) const {
+  return offset_[u] + i;
 }
 
 #endif  // CANDIDATE_SET_H_
@@ -0,0 +1,77 @@
+/**
+ * @file candidate_space.h
+ *
+ */
+
+#ifndef CANDIDATE_SPACE_H_
+#define CANDIDATE_SPACE_H_
+
+#include <cstdint>
+
+#include "candidate_set.h"
+#include "common.h"
+#include "dag.h"
+#include "graph.h"
+
+/*
+ * Candidate space of DAF: for every DAG edge (p, u) and every candidate v of
+ * p, the candidates of u that are adjacent to v in the data graph.
+ * Candidates are referred to by their index in the candidate set of their
+ * query vertex, and every list is sorted in ascending order of index.
+ */
+class CandidateSpace {
+ public:
+  CandidateSpace(const Graph &data, const Dag &query, const CandidateSet &cs);
+  ~CandidateSpace();
+
+  inline size_t GetEdgeCandidateSize(Vertex u, size_t j, size_t i) const;
+  inline const uint32_t *GetEdgeCandidates(Vertex u, size_t j, size_t i) const;
+
+ private:
+  inline size_t ListId(Vertex u, size_t j, size_t i) const;
+
+  /*first_edge_[u] + j: id of the DAG edge from the j-th parent of u to u*/
+  std::vector<size_t> first_edge_;
+  /*first_list_[e] + i: id of the list of edge e for the i-th candidate of the
+  parent. every edge has one more list id, so that list ends are offsets too*/
+  std::vector<size_t> first_list_;
+  /*lists of all edges in one array: list l is [offset_[l], offset_[l + 1])*/
+  std::vector<size_t> offset_;
+  std::vector<uint32_t> index_;
+};
+
+/*id of the list of the edge (j-th parent of u, u) for the i-th candidate of
+the parent*/
+inline size_t CandidateSpace::ListId(Vertex u, size_t j, size_t i) const {
+  return first_list_[first_edge_[u] + j] + i;
+}
+
+/**
+ * @brief Returns the number of candidates of u that are adjacent to the i-th
+ * candidate of the j-th parent of u.
+ *
+ * @param u query vertex id.
+ * @param j index in half-open interval [0, GetParentSize(u)).
+ * @param i index in the candidate set of the j-th parent of u.
+ * @return size_t
+ */
+inline size_t CandidateSpace::GetEdgeCandidateSize(Vertex u, size_t j,
+                                                   size_t i) const {
+  size_t l = ListId(u, j, i);
+  return offset_[l + 1] - offset_[l];
+}
+/**
+ * @brief Returns the candidates of u (as indices in the candidate set of u)
+ * that are adjacent to the i-th candidate of the j-th parent of u.
+ *
+ * @param u query vertex id.
+ * @param j index in half-open interval [0, GetParentSize(u)).
+ * @param i index in the candidate set of the j-th parent of u.
+ * @return const uint32_t* array of GetEdgeCandidateSize(u, j, i) indices.
+ */
+inline const uint32_t *CandidateSpace::GetEdgeCandidates(Vertex u, size_t j,
+                                                         size_t i) const {
+  return index_.data() + offset_[ListId(u, j, i)];
+}
+
+#endif  // CANDIDATE_SPACE_H_
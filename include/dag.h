@@ -5,8 +5,11 @@
 #ifndef DAG_H
 #define DAG_H
 #include "candidate_set.h"
+#include <cstdint>
+
 #include "common.h"
 #include "graph.h"
+#include "vertex_set.h"
 
 class Dag : public Graph{
 public:
@@ -17,7 +20,29 @@ public:
     inline size_t GetChild(Vertex v, size_t) const;
     inline Vertex GetRoot() const;
     inline virtual bool IsNeighbor(Vertex u, Vertex v) const;
+    inline const VertexSet &GetAncestors(Vertex v) const;
+    inline const std::vector<Vertex> &GetTopologicalOrder() const;
+    inline Vertex GetEquivalenceClass(Vertex v) const;
     ~Dag();
+
+private:
+    //parents of v: parent_[parent_offset_[v]]~parent_[parent_offset_[v+1]], and
+    //likewise its children, in the order of parents and dag_adj
+    std::vector<Vertex> parent_;
+    std::vector<size_t> parent_offset_;
+    std::vector<Vertex> child_;
+    std::vector<size_t> child_offset_;
+    //adjacency matrix of the query graph: bit v of row u, words
+    //adjacency_[u*words_]~adjacency_[(u+1)*words_], is set if u and v are adjacent
+    std::vector<uint64_t> adjacency_;
+    size_t words_;
+    //ancestors_[v]: v and every vertex that has a path to v in the DAG
+    std::vector<VertexSet> ancestors_;
+    //every vertex comes after its parents
+    std::vector<Vertex> topological_order_;
+    //equivalence_class_[v]: smallest vertex with the label of v and the neighbors of v other than
+    //the two of them, so that the vertices of a class can be swapped in any embedding
+    std::vector<Vertex> equivalence_class_;
 };
 
 inline Vertex Dag::GetRoot() const {
@@ -25,25 +50,36 @@ inline Vertex Dag::GetRoot() const {
 }
 
 inline size_t Dag::GetParent(Vertex v, size_t i) const {
-    return parents[v][i];
+    return parent_[parent_offset_[v] + i];
 }
 
 inline size_t Dag::GetChild(Vertex v, size_t i) const {
-    return dag_adj[v][i];
+    return child_[child_offset_[v] + i];
 }
 
 inline size_t Dag::GetChildSize(Vertex v) const {
-    return dag_adj[v].size();
+    return child_offset_[v + 1] - child_offset_[v];
 }
 
 inline size_t Dag::GetParentSize(Vertex v) const {
-    return parents[v].size();
+    return parent_offset_[v + 1] - parent_offset_[v];
+}
+
+inline const VertexSet &Dag::GetAncestors(Vertex v) const {
+    return ancestors_[v];
+}
+
+inline const std::vector<Vertex> &Dag::GetTopologicalOrder() const {
+    return topological_order_;
+}
+
+inline Vertex Dag::GetEquivalenceClass(Vertex v) const {
+    return equivalence_class_[v];
 }
 
+//true if u and v are adjacent in the query graph, in either direction of the DAG
 inline bool Dag::IsNeighbor(Vertex u, Vertex v) const {
-    auto it = find(parents[u].begin(), parents[u].end(), v);
-    auto it2 = find(parents[v].begin(), parents[v].end(), u);
-    return it!=parents[u].end()||it2!=parents[v].end();
+    return (adjacency_[u * words_ + (v >> 6)] >> (v & 63)) & 1;
 }
 
 #endif //DAG_H
@@ -0,0 +1,89 @@
+/**
+ * @file edge_index.h
+ * @brief constant-time edge membership test of a graph
+ *
+ */
+
+#ifndef EDGE_INDEX_H_
+#define EDGE_INDEX_H_
+
+#include <cstdint>
+
+#include "common.h"
+
+class Graph;
+
+/*
+ * Hubs, the vertices whose adjacency bitmap is not larger than their
+ * neighbor list, get a bitmap over all vertices; every other edge is a key of
+ * an open-addressing hash table with linear probing, kept at most half full.
+ * An edge test is then one bit or an expected O(1) probe, instead of a binary
+ * search in a neighbor range.
+ */
+class EdgeIndex {
+ public:
+  EdgeIndex() : words_(0), mask_(0), shift_(64) {}
+  explicit EdgeIndex(const Graph &graph);
+
+  inline bool Empty() const;
+  inline bool Contains(Vertex u, Vertex v) const;
+  size_t GetMemorySize() const;
+
+ private:
+  inline static uint64_t Key(Vertex u, Vertex v);
+  inline size_t Slot(uint64_t key) const;
+
+  static const uint64_t kEmptyKey = ~0ULL;
+
+  // hub_[v]: index of the bitmap of v, or -1 if v is not a hub
+  std::vector<int32_t> hub_;
+  // bitmap k is words [k * words_, (k + 1) * words_); bit w of it is set if
+  // w is a neighbor of the k-th hub
+  std::vector<uint64_t> bitmaps_;
+  size_t words_;
+
+  // edges between two vertices that are not hubs
+  std::vector<uint64_t> table_;
+  size_t mask_;  // table_.size() - 1, a power of two minus one
+  int shift_;    // 64 - log2(table_.size())
+};
+
+/**
+ * @brief Returns true if the index was not built.
+ *
+ * @return bool
+ */
+inline bool EdgeIndex::Empty() const { return hub_.empty(); }
+
+/**
+ * @brief Returns true if there is an edge between u and v.
+ *
+ * @param u vertex id.
+ * @param v vertex id.
+ * @return bool
+ */
+inline bool EdgeIndex::Contains(Vertex u, Vertex v) const {
+  if (hub_[u] != -1)
+    return (bitmaps_[hub_[u] * words_ + v / 64] >> (v % 64)) & 1;
+  if (hub_[v] != -1)
+    return (bitmaps_[hub_[v] * words_ + u / 64] >> (u % 64)) & 1;
+
+  uint64_t key = Key(u, v);
+  for (size_t i = Slot(key);; i = (i + 1) & mask_) {
+    if (table_[i] == key) return true;
+    if (table_[i] == kEmptyKey) return false;
+  }
+}
+
+/*the edge as one integer, the same for both directions*/
+inline uint64_t EdgeIndex::Key(Vertex u, Vertex v) {
+  if (u > v) std::swap(u, v);
+  return static_cast<uint64_t>(u) << 32 | static_cast<uint32_t>(v);
+}
+
+/*Fibonacci hashing: the high bits of the key times 2^64 / golden ratio*/
+inline size_t EdgeIndex::Slot(uint64_t key) const {
+  return (key * 0x9e3779b97f4a7c15ULL) >> shift_;
+}
+
+#endif  // EDGE_INDEX_H_
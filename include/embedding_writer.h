@@ -0,0 +1,76 @@
+/**
+ * @file embedding_writer.h
+ * @brief buffered output of embeddings as text or compact binary
+ *
+ */
+
+#ifndef EMBEDDING_WRITER_H_
+#define EMBEDDING_WRITER_H_
+
+#include <cstdint>
+
+#include "common.h"
+
+/*
+ * text: "t <# of query vertices>" and then one "a <v_0> <v_1> ... " line per
+ * embedding, as main/program has always printed.
+ *
+ * binary: a header (magic "IEMBEDS1", then the version, a byte-order mark and
+ * the # of query vertices as native 32-bit integers), then blocks. A block is
+ * the # of embeddings and the # of payload bytes (32-bit), and the payload:
+ * for each embedding, for each query vertex u, the difference from the data
+ * vertex of u in the previous embedding of the block (0 for the first) as a
+ * zigzag LEB128 varint. Blocks can be decoded independently.
+ */
+enum OutputFormat { kTextOutput, kBinaryOutput };
+
+bool ParseOutputFormat(const std::string &name, OutputFormat &format);
+
+/*
+ * Formats embeddings into a large buffer and writes it with write(2) when it
+ * is full. Not thread-safe: concurrent writers must serialize Write.
+ */
+class EmbeddingWriter {
+ public:
+  EmbeddingWriter(int fd, OutputFormat format, size_t buffer_size = 1 << 20);
+  ~EmbeddingWriter();
+
+  void WriteHeader(size_t num_query_vertices);
+  void Write(const Vertex *embedding, size_t size);
+  bool Flush();
+
+  inline OutputFormat GetFormat() const;
+  inline bool Ok() const;
+
+ private:
+  void Reserve(size_t size);
+  bool WriteAll(const char *data, size_t size);
+
+  int fd_;
+  OutputFormat format_;
+  bool ok_;  // false once a write fails
+
+  std::vector<char> buffer_;
+  size_t size_;  // # of bytes in buffer_
+
+  // binary blocks: # of embeddings in the block and the previous embedding
+  uint32_t block_embeddings_;
+  std::vector<Vertex> previous_;
+};
+
+/**
+ * @brief Returns the format the writer produces.
+ *
+ * @return OutputFormat
+ */
+inline OutputFormat EmbeddingWriter::GetFormat() const { return format_; }
+/**
+ * @brief Returns false if some write has failed.
+ *
+ * @return bool
+ */
+inline bool EmbeddingWriter::Ok() const { return ok_; }
+
+bool DecodeEmbeddings(const std::string &filename, EmbeddingWriter &out);
+
+#endif  // EMBEDDING_WRITER_H_
@@ -6,12 +6,32 @@
 #ifndef GRAPH_H_
 #define GRAPH_H_
 
+#include <cstdint>
+#include <memory>
+
+#include "array.h"
 #include "common.h"
 #include "candidate_set.h"
+#include "edge_index.h"
+
+struct GraphFile;
+
+/*
+ * Order of the internal vertex ids of a data graph. The ids of the file are
+ * kept for the boundary: candidate set files and embeddings use them.
+ *  - input: the ids of the file.
+ *  - label: grouped by label, then by descending degree.
+ *  - bfs: Cuthill-McKee, breadth-first by ascending degree.
+ */
+enum VertexOrder { kInputOrder, kLabelDegreeOrder, kBFSOrder };
+
+bool ParseVertexOrder(const std::string &name, VertexOrder &order);
 
 class Graph {
  public:
-  explicit Graph(const std::string& filename, bool is_query = false);
+  explicit Graph(const std::string& filename, bool is_query = false,
+                 bool dense_label_index = false,
+                 VertexOrder order = kInputOrder);
   explicit Graph(const std::string& filename, const CandidateSet &candidateSet, bool is_query = false);
   ~Graph();
   Vertex root;
@@ -34,26 +54,78 @@ class Graph {
 
   inline size_t GetNeighborStartOffset(Vertex v, Label l) const;
   inline size_t GetNeighborEndOffset(Vertex v, Label l) const;
+  inline std::pair<size_t, size_t> GetNeighborRange(Vertex v, Label l) const;
 
   inline Label GetLabel(Vertex v) const;
   inline Vertex GetNeighbor(size_t offset) const;
 
+  inline bool IsReordered() const;
+  inline Vertex GetOriginalId(Vertex v) const;
+  inline Vertex GetInternalId(Vertex v) const;
+
   inline virtual bool IsNeighbor(Vertex u, Vertex v) const;
+  void BuildEdgeIndex();
+  inline const EdgeIndex &GetEdgeIndex() const;
+
+  size_t IntersectNeighbors(Vertex v, Label l, const Vertex *candidates,
+                            size_t size, Vertex *out) const;
+
+  static bool IsSnapshot(const std::string &filename);
+  bool SaveSnapshot(const std::string &filename) const;
 
  private:
+  bool LoadSnapshot(const std::string &filename, bool dense_label_index);
+  void BuildLabelIndex(bool dense_label_index);
+  void BuildDenseLabelIndex();
+  void Reorder(GraphFile &file, VertexOrder order);
+  bool BuildInternalIds();
+
+  static void TransferLabel(const std::vector<Label> &labels);
+  static Label Transferred(Label l);
+
+  // transferred_label_[l]: label id of label l of the data graph file, in
+  // ascending order of l. Set by the data graph and used by the queries.
+  static std::vector<Label> transferred_label_;
+  // label id of the labels that the data graph does not have
+  static Label unknown_label_;
+
   int32_t graph_id_;
 
   size_t num_vertices_;
   size_t num_edges_;
   size_t num_labels_;
 
-  std::vector<size_t> label_frequency_;
+  Array<size_t> label_frequency_;
 
-  std::vector<size_t> start_offset_;
-  std::vector<std::pair<size_t, size_t>> start_offset_by_label_;
+  Array<size_t> start_offset_;
 
-  std::vector<Label> label_;
-  std::vector<Vertex> adj_array_;
+  // label directory: the neighbors of v form one run per label, in ascending
+  // order of label. The runs of v are [label_run_offset_[v],
+  // label_run_offset_[v + 1]) and end with a sentinel run of label INT32_MAX;
+  // run k starts at offset start_offset_[v] + run_start_[k] and ends where
+  // run k + 1 starts
+  Array<size_t> label_run_offset_;
+  Array<Label> run_label_;
+  Array<uint32_t> run_start_;
+  // start_offset_by_label_[v * (max_label_ + 1) + l]: offsets of the neighbors
+  // of v with label l, an empty range where they would be if v has none, as
+  // the directory gives. Built only on request, since it takes |V| * |Σ| pairs;
+  // lookups use it instead of the directory when it is not empty
+  Array<std::pair<size_t, size_t>> start_offset_by_label_;
+
+  Array<Label> label_;
+  Array<Vertex> adj_array_;
+
+  // original_id_[v]: id in the file of the internal vertex v, and
+  // internal_id_ its inverse. Both are empty unless the graph is reordered
+  Array<Vertex> original_id_;
+  Array<Vertex> internal_id_;
+
+  // built on request, see BuildEdgeIndex
+  EdgeIndex edge_index_;
+
+  // mapped snapshot file viewed by the arrays above, if any
+  std::shared_ptr<void> snapshot_;
 
   Label max_label_;
 };
@@ -101,7 +173,8 @@ inline size_t Graph::GetLabelFrequency(Label l) const {
  * @return size_t
  */
 inline size_t Graph::GetNeighborLabelFrequency(Vertex v, Label l) const {
-  return GetNeighborEndOffset(v, l) - GetNeighborStartOffset(v, l);
+  std::pair<size_t, size_t> range = GetNeighborRange(v, l);
+  return range.second - range.first;
 }
 /**
  * @brief Returns the degree of the vertex v.
@@ -133,25 +206,53 @@ inline size_t Graph::GetNeighborEndOffset(Vertex v) const {
 
 /**
  * @brief Returns the start offset of the neighbor of v with label l. If there
- * is no neighbors of v with label l, it returns 0.
+ * is no neighbor of v with label l, it returns the end offset.
  *
  * @param v vertex id.
  * @param l label id of v's neighbor.
  * @return size_t
  */
 inline size_t Graph::GetNeighborStartOffset(Vertex v, Label l) const {
-  return start_offset_by_label_[v * (max_label_ + 1) + l].first;
+  return GetNeighborRange(v, l).first;
 }
 /**
  * @brief Returns the end offset of the neighbor of v with label l. If there is
- * no neighbor of v with label l, it returns 0.
+ * no neighbor of v with label l, it returns the start offset.
  *
  * @param v vertex id.
  * @param l label of v's neighbor.
  * @return size_t
  */
 inline size_t Graph::GetNeighborEndOffset(Vertex v, Label l) const {
-  return start_offset_by_label_[v * (max_label_ + 1) + l].second;
+  return GetNeighborRange(v, l).second;
+}
+/**
+ * @brief Returns the start and end offsets of the neighbors of v with label l,
+ * with one lookup. If v has no neighbor with label l, the range is empty and
+ * at the position where such neighbors would be in the sorted neighbors.
+ *
+ * @param v vertex id.
+ * @param l label of v's neighbor.
+ * @return std::pair<size_t, size_t>
+ */
+inline std::pair<size_t, size_t> Graph::GetNeighborRange(Vertex v,
+                                                         Label l) const {
+  if (!start_offset_by_label_.empty()) {
+    // labels outside the table sort before or after every neighbor
+    if (l < 0) return std::make_pair(start_offset_[v], start_offset_[v]);
+    if (l > max_label_)
+      return std::make_pair(start_offset_[v + 1], start_offset_[v + 1]);
+    return start_offset_by_label_[v * (max_label_ + 1) + l];
+  }
+
+  // the sentinel run is not searched, so that run k + 1 always exists
+  const Label *first = run_label_.data() + label_run_offset_[v];
+  const Label *last = run_label_.data() + label_run_offset_[v + 1] - 1;
+  const Label *it = std::lower_bound(first, last, l);
+  size_t k = it - run_label_.data();
+  size_t start = start_offset_[v] + run_start_[k];
+  if (it == last || *it != l) return std::make_pair(start, start);
+  return std::make_pair(start, start_offset_[v] + run_start_[k + 1]);
 }
 
 /**
@@ -173,30 +274,62 @@ inline Vertex Graph::GetNeighbor(size_t offset) const {
   return adj_array_[offset];
 }
 
+/**
+ * @brief Returns true if the internal vertex ids differ from those of the
+ * file.
+ *
+ * @return bool
+ */
+inline bool Graph::IsReordered() const { return !original_id_.empty(); }
+/**
+ * @brief Returns the id in the graph file of the vertex v.
+ *
+ * @param v vertex id.
+ * @return Vertex
+ */
+inline Vertex Graph::GetOriginalId(Vertex v) const {
+  return IsReordered() ? original_id_[v] : v;
+}
+/**
+ * @brief Returns the vertex id of the vertex v of the graph file.
+ *
+ * @param v vertex id in the graph file, less than GetNumVertices().
+ * @return Vertex
+ */
+inline Vertex Graph::GetInternalId(Vertex v) const {
+  return IsReordered() ? internal_id_[v] : v;
+}
+
+/**
+ * @brief Returns the edge index, empty unless BuildEdgeIndex was called.
+ *
+ * @return const EdgeIndex&
+ */
+inline const EdgeIndex &Graph::GetEdgeIndex() const { return edge_index_; }
+
 /**
  * @brief Returns true if there is an edge between u and v, otherwise return
- * false.
+ * false. Uses the edge index if it is built, and otherwise a binary search in
+ * the neighbors of one of them with the label of the other.
  *
  * @param u vertex id.
  * @param v vertex id.
  * @return bool
  */
 inline bool Graph::IsNeighbor(Vertex u, Vertex v) const {
-  if (GetNeighborLabelFrequency(u, GetLabel(v)) >
-      GetNeighborLabelFrequency(v, GetLabel(u)))
+  if (!edge_index_.Empty()) return edge_index_.Contains(u, v);
+
+  std::pair<size_t, size_t> range = GetNeighborRange(u, GetLabel(v));
+  std::pair<size_t, size_t> reverse = GetNeighborRange(v, GetLabel(u));
+  if (range.second - range.first > reverse.second - reverse.first) {
     std::swap(u, v);
-  auto it = std::lower_bound(
-      adj_array_.begin() + GetNeighborStartOffset(u, GetLabel(v)),
-      adj_array_.begin() + GetNeighborEndOffset(u, GetLabel(v)), v,
-      [this](Vertex u, Vertex v) {
-        if (GetDegree(u) != GetDegree(v))
-          return GetDegree(u) > GetDegree(v);
-        else
-          return u < v;
-      });
-  size_t offset = it - adj_array_.begin();
-  return offset >= GetNeighborStartOffset(u, GetLabel(v)) &&
-         offset < GetNeighborEndOffset(u, GetLabel(v)) && *it == v;
+    range = reverse;
+  }
+  // neighbors with the same label are sorted by id
+  auto begin = adj_array_.begin() + range.first;
+  auto end = adj_array_.begin() + range.second;
+  auto it = std::lower_bound(begin, end, v);
+  return it != end && *it == v;
 }
 
 
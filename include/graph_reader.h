@@ -0,0 +1,27 @@
+/**
+ * @file graph_reader.h
+ *
+ */
+
+#ifndef GRAPH_READER_H_
+#define GRAPH_READER_H_
+
+#include "common.h"
+
+/*
+ * Contents of an .igraph file:
+ *   t <graph id> <# of vertices>
+ *   v <vertex id> <label>
+ *   e <vertex id> <vertex id> <edge label>
+ * Edge labels are not used by the matching, so they are dropped.
+ */
+struct GraphFile {
+  int32_t graph_id;
+  size_t num_vertices;
+  std::vector<Label> labels; /*labels[v]: label of v as written in the file*/
+  std::vector<std::pair<Vertex, Vertex>> edges;
+};
+
+bool ReadGraphFile(const std::string &filename, GraphFile &file);
+
+#endif  // GRAPH_READER_H_
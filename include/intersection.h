@@ -0,0 +1,29 @@
+/**
+ * @file intersection.h
+ * @brief intersection of sorted arrays of distinct integers
+ *
+ */
+
+#ifndef INTERSECTION_H_
+#define INTERSECTION_H_
+
+#include <cstdint>
+
+#include "common.h"
+
+/*
+ * Both inputs must be sorted in ascending order without duplicates. The
+ * common elements are written to out in ascending order, and their number is
+ * returned. out may be the same array as a (in-place filtering of a), but must
+ * have room for min(a_size, b_size) elements.
+ *
+ * Skewed inputs are intersected by galloping the smaller one through the
+ * larger one, others by a SIMD block merge (SSE2, or AVX2 when it is enabled
+ * at compile time) with a scalar merge for the tail.
+ */
+size_t IntersectSorted(const int32_t *a, size_t a_size, const int32_t *b,
+                       size_t b_size, int32_t *out);
+size_t IntersectSorted(const uint32_t *a, size_t a_size, const uint32_t *b,
+                       size_t b_size, uint32_t *out);
+
+#endif  // INTERSECTION_H_
@@ -0,0 +1,115 @@
+/**
+ * @file matching_order.h
+ * @brief strategies choosing the next query vertex to match
+ *
+ */
+
+#ifndef MATCHING_ORDER_H_
+#define MATCHING_ORDER_H_
+
+#include <cstdint>
+
+#include "candidate_set.h"
+#include "candidate_space.h"
+#include "common.h"
+#include "dag.h"
+#include "graph.h"
+
+/*
+ * The backtracker maps a query vertex once all of its DAG parents are mapped
+ * (an extendable vertex), and among the extendable vertices it maps the one
+ * with the smallest key:
+ *  - candidate-size order (DAF): # of extendable candidates.
+ *  - path-size order (DAF): sum of the weights of the extendable candidates,
+ *    where the weight of a candidate estimates the # of embeddings of the
+ *    paths below it in the candidate space.
+ *  - GQL and RI orders: rank in a static order of the query graph, computed
+ *    once as in GraphQL (fewest candidates next to the matched vertices) and
+ *    RI (most edges to the matched vertices).
+ */
+enum OrderType { kCandidateSizeOrder, kPathSizeOrder, kGQLOrder, kRIOrder };
+
+bool ParseOrderType(const std::string &name, OrderType &type);
+
+class MatchingOrder {
+ public:
+  MatchingOrder(const Dag &query, const CandidateSet &cs,
+                const CandidateSpace &space, OrderType type);
+  ~MatchingOrder();
+
+  inline OrderType GetType() const;
+  double GetKey(Vertex u, const uint32_t *extendable, size_t size) const;
+
+ private:
+  void ComputeWeights(const Dag &query, const CandidateSet &cs,
+                      const CandidateSpace &space);
+  void ComputeGQLRank(const Dag &query, const CandidateSet &cs);
+  void ComputeRIRank(const Dag &query);
+  void SetRank(const std::vector<Vertex> &order);
+
+  OrderType type_;
+
+  const CandidateSet &cs_;
+
+  // weight_[cs.GetCandidateId(u, i)]: weight of the i-th candidate of u, for
+  // the path-size order
+  std::vector<double> weight_;
+  // rank_[u]: position of u in the static order, for the GQL and RI orders
+  std::vector<size_t> rank_;
+};
+
+/**
+ * @brief Returns the strategy of the order.
+ *
+ * @return OrderType
+ */
+inline OrderType MatchingOrder::GetType() const { return type_; }
+
+/*
+ * Binary min-heap of query vertices by key, with ties broken by vertex id,
+ * that can remove any vertex. Its storage is allocated once.
+ */
+class VertexHeap {
+ public:
+  VertexHeap() {}
+  explicit VertexHeap(size_t num_vertices);
+
+  void Push(Vertex u, double key);
+  void Remove(Vertex u);
+
+  inline bool Empty() const;
+  inline bool Contains(Vertex u) const;
+  inline Vertex Top() const;
+
+ private:
+  void Place(size_t i, const std::pair<double, Vertex> &entry);
+  void SiftUp(size_t i, std::pair<double, Vertex> entry);
+  void SiftDown(size_t i, std::pair<double, Vertex> entry);
+
+  std::vector<std::pair<double, Vertex>> heap_;
+  size_t size_;
+  // position_[u]: index of u in heap_, or -1 if u is not in the heap
+  std::vector<int32_t> position_;
+};
+
+/**
+ * @brief Returns true if the heap has no vertex.
+ *
+ * @return bool
+ */
+inline bool VertexHeap::Empty() const { return size_ == 0; }
+/**
+ * @brief Returns true if u is in the heap.
+ *
+ * @param u query vertex id.
+ * @return bool
+ */
+inline bool VertexHeap::Contains(Vertex u) const { return position_[u] != -1; }
+/**
+ * @brief Returns the vertex with the smallest key. The heap must not be empty.
+ *
+ * @return Vertex
+ */
+inline Vertex VertexHeap::Top() const { return heap_[0].second; }
+
+#endif  // MATCHING_ORDER_H_
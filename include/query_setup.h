@@ -0,0 +1,55 @@
+/**
+ * @file query_setup.h
+ * @brief setting up the search of a query, as main/program, the server and
+ * the benchmark do alike
+ *
+ */
+
+#ifndef QUERY_SETUP_H_
+#define QUERY_SETUP_H_
+
+#include <memory>
+
+#include "backtrack.h"
+#include "candidate_set.h"
+#include "common.h"
+#include "dag.h"
+#include "embedding_writer.h"
+#include "graph.h"
+#include "matching_order.h"
+
+/*
+ * Options of a search that every entry point takes:
+ *   [--threads <n>] [--order <order>] [--format <format>] [--mode <mode>]
+ *   [--limit <n>] [--dense-labels] [--reorder <order>] [--verify]
+ *   [--time-limit <seconds>] [--symmetry]
+ */
+struct SearchOptions {
+  size_t num_threads;        /*# of search threads of a query*/
+  OrderType order;           /*matching order*/
+  OutputFormat format;       /*format of the embeddings*/
+  MatchMode mode;            /*print, count or check existence of embeddings*/
+  size_t limit;              /*# of embeddings a query stops at*/
+  bool limit_given;          /*false if limit is the default, which the entry point may choose by the mode*/
+  bool dense_labels;         /*see Graph::BuildDenseLabelIndex*/
+  VertexOrder vertex_order;  /*order of the vertices of the data graph*/
+  bool verify;               /*check the embeddings, see Backtrack::SetVerification*/
+  double time_limit;         /*seconds the search of a query may take, 0 for no limit*/
+  bool symmetry;             /*see Backtrack::SetSymmetryBreaking*/
+
+  SearchOptions();
+};
+
+bool ParseSearchOption(int argc, char *argv[], int &i, SearchOptions &options);
+
+/*candidate set of a query, and the DAG of the query rooted by it*/
+struct PreparedQuery {
+  std::unique_ptr<CandidateSet> candidate_set;
+  std::unique_ptr<Dag> dag;
+  double dag_ms;  /*time of building dag, which the benchmark reports apart*/
+};
+
+PreparedQuery PrepareQuery(const Graph &data, const std::string &query_file_name,
+                           const std::string &candidate_set_file_name);
+
+#endif  // QUERY_SETUP_H_
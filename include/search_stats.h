@@ -0,0 +1,61 @@
+/**
+ * @file search_stats.h
+ * @brief counters of the backtracking search
+ *
+ */
+
+#ifndef SEARCH_STATS_H_
+#define SEARCH_STATS_H_
+
+#include <cstdint>
+
+#include "common.h"
+
+/*
+ * The counters are updated on the hot path only when the build defines
+ * ENABLE_STATS (cmake -DENABLE_STATS=ON); otherwise SEARCH_STAT(...) expands
+ * to nothing and the search is not slowed down. Each worker counts in its own
+ * SearchStats, and the counts are merged when the search ends.
+ */
+#ifdef ENABLE_STATS
+#define SEARCH_STAT(statement) statement
+#else
+#define SEARCH_STAT(statement)
+#endif
+
+struct SearchStats {
+#ifdef ENABLE_STATS
+  static const bool kEnabled = true;
+#else
+  static const bool kEnabled = false;
+#endif
+
+  SearchStats() { Reset(0); }
+
+  void Reset(size_t num_query_vertices);
+  void Merge(const SearchStats &other);
+  std::string ToString() const;
+
+  // nodes_per_depth[d]: # of candidates tried for the vertex mapped d-th
+  std::vector<uint64_t> nodes_per_depth;
+  // candidates skipped because another query vertex is mapped to them
+  uint64_t injectivity_conflicts;
+  // candidates skipped because they would map equivalent query vertices out
+  // of order (see Backtrack::SetSymmetryBreaking)
+  uint64_t symmetry_conflicts;
+  // candidates of a vertex removed by the intersection with the lists of its
+  // other mapped parents, i.e. by edge checks
+  uint64_t edge_rejections;
+  // sorted-set intersections of candidate space lists
+  uint64_t intersections;
+  // vertices chosen to be matched next without any extendable candidate
+  uint64_t empty_extendable;
+  // candidate loops cut short because the failing set excludes the vertex
+  uint64_t failing_set_prunes;
+  uint64_t update_extendable_calls;
+  uint64_t update_extendable_ns;
+  // from the start of the search to the first embedding, -1 if none
+  double first_embedding_ms;
+};
+
+#endif  // SEARCH_STATS_H_
@@ -0,0 +1,45 @@
+/**
+ * @file server.h
+ * @brief long-running matching of many queries against one data graph
+ *
+ */
+
+#ifndef SERVER_H_
+#define SERVER_H_
+
+#include "common.h"
+#include "backtrack.h"
+#include "embedding_writer.h"
+#include "graph.h"
+#include "matching_order.h"
+#include "query_setup.h"
+
+/*
+ * Every request is one line
+ *   <query graph file> <candidate set file> <output file>
+ * and is answered, when it is finished, by one line
+ *   done <query graph file> <# of embeddings> <load ms> <search ms> [truncated]
+ * or
+ *   error <query graph file> <message>
+ * where load ms covers the candidate set and the query DAG. A request whose
+ * query graph or candidate set file is missing or malformed is answered by an
+ * error and does not affect the others.
+ * Embeddings are written to the output file in the format of main/program
+ * (see embedding_writer.h). A
+ * candidate set file of "-" makes the server filter the candidates itself.
+ * Unless the mode is print, embeddings are only counted and the output file
+ * is not written. A query that runs out of its time limit answers with the
+ * embeddings found until then, marked truncated.
+ * SIGTERM or SIGINT cancel the running queries, which answer likewise marked
+ * truncated; the server then reads no more requests and exits once they are
+ * answered.
+ */
+struct ServerOptions {
+  std::string socket_path; /*UNIX socket to listen on, stdin/stdout if empty*/
+  size_t num_jobs;         /*# of queries matched concurrently*/
+  SearchOptions search;    /*search of each query; the format is that of the output files*/
+};
+
+int RunServer(const Graph &data, const ServerOptions &options);
+
+#endif  // SERVER_H_
@@ -0,0 +1,70 @@
+/**
+ * @file vertex_set.h
+ * @brief fixed-size bitset of vertices
+ *
+ */
+
+#ifndef VERTEX_SET_H_
+#define VERTEX_SET_H_
+
+#include <cstdint>
+
+#include "common.h"
+
+class VertexSet {
+ public:
+  VertexSet() {}
+  explicit VertexSet(size_t num_vertices)
+      : words_((num_vertices + 63) / 64, 0) {}
+
+  inline void Insert(Vertex v);
+  inline bool Contains(Vertex v) const;
+  inline bool Empty() const;
+  inline void Clear();
+  inline void Union(const VertexSet &other);
+
+ private:
+  std::vector<uint64_t> words_;
+};
+
+/**
+ * @brief Adds v to the set.
+ *
+ * @param v vertex id in [0, num_vertices).
+ */
+inline void VertexSet::Insert(Vertex v) {
+  words_[v >> 6] |= uint64_t(1) << (v & 63);
+}
+/**
+ * @brief Returns true if v is in the set.
+ *
+ * @param v vertex id in [0, num_vertices).
+ * @return bool
+ */
+inline bool VertexSet::Contains(Vertex v) const {
+  return (words_[v >> 6] >> (v & 63)) & 1;
+}
+/**
+ * @brief Returns true if no vertex is in the set.
+ *
+ * @return bool
+ */
+inline bool VertexSet::Empty() const {
+  for (uint64_t word : words_)
+    if (word != 0) return false;
+  return true;
+}
+/**
+ * @brief Removes every vertex from the set.
+ */
+inline void VertexSet::Clear() { std::fill(words_.begin(), words_.end(), 0); }
+/**
+ * @brief Adds every vertex of other, a set of the same size, to the set.
+ *
+ * @param other
+ */
+inline void VertexSet::Union(const VertexSet &other) {
+  for (size_t i = 0; i < words_.size(); ++i) words_[i] |= other.words_[i];
+}
+
+#endif  // VERTEX_SET_H_
@@ -0,0 +1,94 @@
+/**
+ * @file work_stealing_pool.h
+ *
+ */
+
+#ifndef WORK_STEALING_POOL_H_
+#define WORK_STEALING_POOL_H_
+
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "common.h"
+
+/*a subtree of the search: replay prefix, then try candidates for next.
+candidates are given by their index in the candidate set of their query vertex*/
+struct SearchTask {
+  /*(query vertex, candidate index) pairs in the order they were mapped*/
+  std::vector<std::pair<Vertex, uint32_t>> prefix;
+  /*query vertex to be mapped at the root of this subtree*/
+  Vertex next;
+  /*candidates of next that are left to be tried*/
+  std::vector<uint32_t> candidates;
+};
+
+class WorkStealingPool {
+ public:
+  explicit WorkStealingPool(size_t num_workers);
+  ~WorkStealingPool();
+
+  void Push(size_t worker, SearchTask &&task);
+  void Run(const std::function<void(size_t, SearchTask &)> &run_task);
+  void Stop();
+
+  inline size_t GetNumWorkers() const;
+  inline bool IsStopped() const;
+  inline bool IsHungry() const;
+
+ private:
+  bool Take(size_t worker, SearchTask &task);
+  void WorkerLoop(size_t worker,
+                  const std::function<void(size_t, SearchTask &)> &run_task);
+
+  struct TaskQueue {
+    std::mutex lock;
+    std::deque<SearchTask> tasks;
+  };
+
+  std::vector<std::unique_ptr<TaskQueue>> queues_;
+
+  std::atomic<size_t> pending_; /*# of tasks pushed but not finished yet*/
+  std::atomic<size_t> queued_;  /*# of tasks waiting in some queue*/
+  std::atomic<size_t> idle_;    /*# of workers looking for a task*/
+  std::atomic<bool> stopped_;
+
+  std::mutex wait_lock_;
+  std::condition_variable wait_cv_;
+};
+
+/**
+ * @brief Returns the number of worker threads of the pool.
+ *
+ * @return size_t
+ */
+inline size_t WorkStealingPool::GetNumWorkers() const {
+  return queues_.size();
+}
+
+/**
+ * @brief Returns true if Stop() was called, e.g. because the embedding limit
+ * was reached.
+ *
+ * @return bool
+ */
+inline bool WorkStealingPool::IsStopped() const {
+  return stopped_.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Returns true if some worker is idle and no queued task is left for
+ * it, i.e. a running worker should split off part of its subtree.
+ *
+ * @return bool
+ */
+inline bool WorkStealingPool::IsHungry() const {
+  return idle_.load(std::memory_order_relaxed) >
+         queued_.load(std::memory_order_relaxed);
+}
+
+#endif  // WORK_STEALING_POOL_H_
@@ -0,0 +1,447 @@
+/**
+ * @file benchmark.cc
+ * @brief times the shipped workloads and compares them with a baseline
+ *
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <sstream>
+
+#include "backtrack.h"
+#include "common.h"
+#include "embedding_writer.h"
+#include "graph.h"
+#include "query_setup.h"
+
+namespace {
+
+struct Options {
+  std::string root;      /*directory with data/, query/ and candidate/*/
+  int warmup;            /*untimed trials of each workload*/
+  int trials;            /*timed trials of each workload*/
+  double timeout;        /*seconds a trial may take*/
+  SearchOptions search;  /*embeddings are printed to /dev/null*/
+  bool filter;           /*filter candidates in process, not from a file*/
+  std::string output;    /*JSON report, stdout if empty*/
+  std::string baseline;  /*JSON report to compare with, if any*/
+  double tolerance;      /*allowed slowdown of the fastest search and DAG*/
+};
+
+/*what a trial sends back from its process*/
+struct TrialResult {
+  double load_ms;       /*data graph*/
+  double candidate_ms;  /*candidate set*/
+  double dag_ms;        /*query DAG*/
+  double space_ms;      /*candidate space and matching order*/
+  double search_ms;
+  uint64_t embeddings;
+};
+
+struct Trial {
+  enum Status { kDone, kTimeout, kError } status;
+  TrialResult result;
+  long peak_rss_kb;
+};
+
+struct Report {
+  std::string name;
+  int timeouts;
+  int errors;
+  uint64_t embeddings;
+  // medians of the finished trials
+  double load_ms, candidate_ms, dag_ms, space_ms, search_ms;
+  double min_dag_ms, min_search_ms;
+  double embeddings_per_sec;
+  long peak_rss_kb;
+};
+
+double Milliseconds(std::chrono::steady_clock::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+double Median(std::vector<double> values) {
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  size_t n = values.size();
+  return n % 2 == 1 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+/*runs one workload in this process, as main/program does*/
+TrialResult RunWorkload(const Options &options, const std::string &name) {
+  std::string dataset = name.substr(0, name.find('_'));
+  std::string query_id = name.substr(name.find('_') + 1);
+  std::string data_file_name =
+      options.root + "/data/lcc_" + dataset + ".igraph";
+  std::string query_file_name =
+      options.root + "/query/lcc_" + name + ".igraph";
+  std::string candidate_set_file_name = options.root + "/candidate/lcc_" +
+                                        dataset + "_c" + query_id + ".igraph";
+
+  TrialResult result;
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  const SearchOptions &search = options.search;
+  Graph data(data_file_name, false, search.dense_labels, search.vertex_order);
+  if (search.verify) data.BuildEdgeIndex();
+  std::chrono::steady_clock::time_point loaded =
+      std::chrono::steady_clock::now();
+
+  PreparedQuery query = PrepareQuery(
+      data, query_file_name, options.filter ? "-" : candidate_set_file_name);
+  std::chrono::steady_clock::time_point queried =
+      std::chrono::steady_clock::now();
+
+  int fd = open("/dev/null", O_WRONLY);
+  EmbeddingWriter out(fd, search.format);
+  Backtrack backtrack(data, *query.dag, *query.candidate_set,
+                      search.num_threads, &out, search.order);
+  backtrack.SetVerification(search.verify);
+  backtrack.SetTimeLimit(search.time_limit);
+  backtrack.SetSymmetryBreaking(search.symmetry);
+  std::chrono::steady_clock::time_point prepared =
+      std::chrono::steady_clock::now();
+
+  if (search.mode == kPrintMatches)
+    backtrack.PrintAllMatches(search.limit);
+  else
+    backtrack.CountMatches(search.mode == kExistsMatch ? 1 : search.limit);
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  close(fd);
+  if (backtrack.GetNumInvalidEmbeddings() > 0)
+    throw std::runtime_error(
+        std::to_string(backtrack.GetNumInvalidEmbeddings()) +
+        " embeddings failed verification");
+
+  result.load_ms = Milliseconds(loaded - start);
+  result.dag_ms = query.dag_ms;
+  result.candidate_ms = Milliseconds(queried - loaded) - query.dag_ms;
+  result.space_ms = Milliseconds(prepared - queried);
+  result.search_ms = Milliseconds(end - prepared);
+  result.embeddings = backtrack.GetNumEmbeddings();
+  return result;
+}
+
+/*runs a trial in a child process, so that it can be killed at the timeout
+and its peak RSS is its own*/
+Trial RunTrial(const Options &options, const std::string &name) {
+  Trial trial;
+  trial.status = Trial::kError;
+  trial.peak_rss_kb = 0;
+
+  int fds[2];
+  if (pipe(fds) != 0) return trial;
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    return trial;
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    TrialResult result;
+    try {
+      result = RunWorkload(options, name);
+    } catch (const std::exception &e) {
+      // a missing or malformed file, or a wrong embedding, fails the trial
+      std::cerr << e.what() << "\n";
+      _exit(EXIT_FAILURE);
+    }
+    ssize_t written = write(fds[1], &result, sizeof(result));
+    _exit(written == sizeof(result) ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+  close(fds[1]);
+
+  // a poll interrupted by a signal is restarted with the time that is left
+  struct pollfd ready = {fds[0], POLLIN, 0};
+  std::chrono::steady_clock::time_point deadline =
+      std::chrono::steady_clock::now() +
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(options.timeout));
+  int polled;
+  do {
+    double left_ms = Milliseconds(deadline - std::chrono::steady_clock::now());
+    int timeout_ms = left_ms > 0 ? static_cast<int>(std::ceil(left_ms)) : 0;
+    polled = poll(&ready, 1, timeout_ms);
+  } while (polled < 0 && errno == EINTR);
+  if (polled <= 0) {
+    // a failed poll fails the trial, rather than blocking in read
+    kill(pid, SIGKILL);
+    if (polled == 0) trial.status = Trial::kTimeout;
+  } else if (read(fds[0], &trial.result, sizeof(trial.result)) ==
+             sizeof(trial.result)) {
+    trial.status = Trial::kDone;
+  }
+  close(fds[0]);
+
+  int status;
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) == pid)
+    trial.peak_rss_kb = usage.ru_maxrss;
+  if (trial.status == Trial::kDone &&
+      !(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS))
+    trial.status = Trial::kError;
+  return trial;
+}
+
+Report Measure(const Options &options, const std::string &name) {
+  for (int i = 0; i < options.warmup; ++i) RunTrial(options, name);
+
+  Report report;
+  report.name = name;
+  report.timeouts = report.errors = 0;
+  report.embeddings = 0;
+  report.peak_rss_kb = 0;
+  std::vector<double> load, candidate, dag, space, search;
+  for (int i = 0; i < options.trials; ++i) {
+    Trial trial = RunTrial(options, name);
+    report.peak_rss_kb = std::max(report.peak_rss_kb, trial.peak_rss_kb);
+    if (trial.status == Trial::kTimeout) {
+      report.timeouts++;
+    } else if (trial.status == Trial::kError) {
+      report.errors++;
+    } else {
+      load.push_back(trial.result.load_ms);
+      candidate.push_back(trial.result.candidate_ms);
+      dag.push_back(trial.result.dag_ms);
+      space.push_back(trial.result.space_ms);
+      search.push_back(trial.result.search_ms);
+      report.embeddings = trial.result.embeddings;
+    }
+  }
+
+  report.load_ms = Median(load);
+  report.candidate_ms = Median(candidate);
+  report.dag_ms = Median(dag);
+  report.space_ms = Median(space);
+  report.search_ms = Median(search);
+  report.min_dag_ms =
+      dag.empty() ? 0 : *std::min_element(dag.begin(), dag.end());
+  report.min_search_ms =
+      search.empty() ? 0 : *std::min_element(search.begin(), search.end());
+  report.embeddings_per_sec =
+      report.search_ms > 0 ? report.embeddings / (report.search_ms / 1000) : 0;
+  return report;
+}
+
+/*one workload per line, so that a baseline can be read back line by line*/
+std::string ToJson(const Options &options, const std::vector<Report> &reports) {
+  std::ostringstream json;
+  json << "{\"trials\": " << options.trials
+       << ", \"warmup\": " << options.warmup
+       << ", \"timeout_s\": " << options.timeout
+       << ", \"threads\": " << options.search.num_threads << ", \"workloads\": [\n";
+  for (size_t i = 0; i < reports.size(); ++i) {
+    const Report &r = reports[i];
+    json << "  {\"name\": \"" << r.name << "\", \"embeddings\": "
+         << r.embeddings << ", \"timeouts\": " << r.timeouts
+         << ", \"errors\": " << r.errors << ", \"load_ms\": " << r.load_ms
+         << ", \"candidate_ms\": " << r.candidate_ms
+         << ", \"dag_ms\": " << r.dag_ms << ", \"space_ms\": " << r.space_ms
+         << ", \"search_ms\": " << r.search_ms
+         << ", \"min_dag_ms\": " << r.min_dag_ms
+         << ", \"min_search_ms\": " << r.min_search_ms
+         << ", \"embeddings_per_sec\": " << r.embeddings_per_sec
+         << ", \"peak_rss_kb\": " << r.peak_rss_kb << "}"
+         << (i + 1 < reports.size() ? "," : "") << "\n";
+  }
+  json << "]}\n";
+  return json.str();
+}
+
+/*value of "key": in a line written by ToJson*/
+bool ReadField(const std::string &line, const std::string &key,
+               std::string &value) {
+  size_t p = line.find("\"" + key + "\": ");
+  if (p == std::string::npos) return false;
+  p += key.size() + 4;
+  size_t end = line.find_first_of(",}", p);
+  value = line.substr(p, end - p);
+  if (!value.empty() && value[0] == '"')
+    value = value.substr(1, value.size() - 2);
+  return true;
+}
+
+/*true if ms grows beyond the tolerance over baseline_ms, and by more than
+noise_ms*/
+bool Slower(double ms, double baseline_ms, double tolerance, double noise_ms) {
+  return ms > baseline_ms * (1 + tolerance) && ms - baseline_ms > noise_ms;
+}
+
+/*compares with the baseline report and prints the regressions: a workload
+that finds another # of embeddings, times out or fails more often, or whose
+fastest search (by more than 1 ms) or fastest DAG construction (by more than
+0.1 ms, it takes well below a millisecond) grows beyond the tolerance. the
+fastest trial is compared, as it is the least disturbed by the rest of the
+machine. a baseline without DAG times, of an older build, is compared by the
+rest. the workloads of the baseline finished if they did not time out or fail
+in all of its own trials, whose # is in its first line*/
+int CompareWithBaseline(const Options &options,
+                        const std::vector<Report> &reports) {
+  std::ifstream fin(options.baseline);
+  if (!fin.is_open()) {
+    std::cerr << "Baseline " << options.baseline << " not found!\n";
+    return -1;
+  }
+  std::map<std::string, Report> baseline;
+  int baseline_trials = options.trials;
+  std::string line, name, embeddings, timeouts, errors, search_ms, dag_ms;
+  std::string trials;
+  while (std::getline(fin, line)) {
+    if (ReadField(line, "trials", trials)) {
+      try {
+        baseline_trials = std::stoi(trials);
+      } catch (const std::exception &) {
+        std::cerr << "Baseline " << options.baseline << " is malformed!\n";
+        return -1;
+      }
+      continue;
+    }
+    if (!ReadField(line, "name", name) ||
+        !ReadField(line, "embeddings", embeddings) ||
+        !ReadField(line, "timeouts", timeouts) ||
+        !ReadField(line, "errors", errors) ||
+        !ReadField(line, "min_search_ms", search_ms))
+      continue;
+    Report &r = baseline[name];
+    try {
+      r.embeddings = std::stoull(embeddings);
+      r.timeouts = std::stoi(timeouts);
+      r.errors = std::stoi(errors);
+      r.min_search_ms = std::stod(search_ms);
+      r.min_dag_ms =
+          ReadField(line, "min_dag_ms", dag_ms) ? std::stod(dag_ms) : -1;
+    } catch (const std::exception &) {
+      std::cerr << "Baseline " << options.baseline << " is malformed!\n";
+      return -1;
+    }
+  }
+
+  int regressions = 0;
+  for (const Report &r : reports) {
+    auto it = baseline.find(r.name);
+    if (it == baseline.end()) continue;
+    const Report &b = it->second;
+    bool finished = r.timeouts + r.errors < options.trials;
+    bool finished_before = b.timeouts + b.errors < baseline_trials;
+    std::ostringstream change;
+    if (r.timeouts > b.timeouts)
+      change << "timeouts " << b.timeouts << " -> " << r.timeouts;
+    else if (r.errors > b.errors)
+      change << "errors " << b.errors << " -> " << r.errors;
+    else if (finished && finished_before && r.embeddings != b.embeddings)
+      change << "embeddings " << b.embeddings << " -> " << r.embeddings;
+    else if (finished && finished_before &&
+             Slower(r.min_search_ms, b.min_search_ms, options.tolerance, 1))
+      change << "search " << b.min_search_ms << " ms -> " << r.min_search_ms
+             << " ms";
+    else if (finished && finished_before && b.min_dag_ms >= 0 &&
+             Slower(r.min_dag_ms, b.min_dag_ms, options.tolerance, 0.1))
+      change << "dag " << b.min_dag_ms << " ms -> " << r.min_dag_ms << " ms";
+    else
+      continue;
+    std::cerr << "regression " << r.name << ": " << change.str() << "\n";
+    regressions++;
+  }
+  return regressions;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+  options.root = ".";
+  options.warmup = 1;
+  options.trials = 5;
+  options.timeout = 60;
+  options.filter = false;
+  options.tolerance = 0.2;
+
+  std::vector<std::string> names;
+  std::string option;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      option = argv[i];
+      bool has_value = i + 1 < argc;
+      if (ParseSearchOption(argc, argv, i, options.search)) continue;
+      if (option == "--root" && has_value) {
+        options.root = argv[++i];
+      } else if (option == "--warmup" && has_value) {
+        options.warmup = std::stoi(argv[++i]);
+      } else if (option == "--trials" && has_value) {
+        options.trials = std::stoi(argv[++i]);
+      } else if (option == "--timeout" && has_value) {
+        options.timeout = std::stod(argv[++i]);
+      } else if (option == "--filter") {
+        options.filter = true;
+      } else if (option == "--output" && has_value) {
+        options.output = argv[++i];
+      } else if (option == "--baseline" && has_value) {
+        options.baseline = argv[++i];
+      } else if (option == "--tolerance" && has_value) {
+        options.tolerance = std::stod(argv[++i]) / 100;
+      } else if (option.compare(0, 2, "--") != 0) {
+        names.push_back(option);
+      } else {
+        std::cerr << "Usage: ./benchmark [--root <dir>] [--warmup <n>] "
+                     "[--trials <n>] [--timeout <seconds>]\n"
+                     "                   [--threads <n>] [--order <order>] "
+                     "[--format <format>] [--mode print|count|exists]\n"
+                     "                   [--limit <n>] [--dense-labels] "
+                     "[--reorder <order>] [--verify]\n"
+                     "                   [--time-limit <seconds>] "
+                     "[--symmetry] [--filter]\n"
+                     "                   [--output <json>] [--baseline <json>] "
+                     "[--tolerance <percent>] [<dataset>_<query> ...]\n";
+        return EXIT_FAILURE;
+      }
+    }
+  } catch (const std::exception &) {
+    // std::stoi, std::stoul and std::stod throw on values that are not numbers
+    std::cerr << "Invalid value for " << option << "\n";
+    return EXIT_FAILURE;
+  }
+
+  // every shipped workload by default, as build/execute.sh runs them
+  if (names.empty()) {
+    const char *datasets[] = {"hprd", "human", "yeast"};
+    for (const char *dataset : datasets)
+      for (char type : {'n', 's'})
+        for (int size : {1, 3, 5, 8})
+          names.push_back(std::string(dataset) + "_" + type +
+                          std::to_string(size));
+  }
+
+  std::vector<Report> reports;
+  for (const std::string &name : names) {
+    reports.push_back(Measure(options, name));
+    const Report &r = reports.back();
+    std::cerr << r.name << ": " << r.embeddings << " embeddings, search "
+              << r.search_ms << " ms, " << r.timeouts << " timeouts\n";
+  }
+
+  std::string json = ToJson(options, reports);
+  if (options.output.empty()) {
+    std::cout << json;
+  } else {
+    std::ofstream fout(options.output);
+    fout << json;
+    if (!fout) {
+      std::cerr << "Cannot write " << options.output << "\n";
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!options.baseline.empty() && CompareWithBaseline(options, reports) != 0)
+    return EXIT_FAILURE;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,37 @@
+/**
+ * @file convert.cc
+ * @brief writes a data graph file as a binary snapshot
+ *
+ */
+
+#include "common.h"
+#include "graph.h"
+
+int main(int argc, char* argv[]) {
+  VertexOrder order = kInputOrder;
+  bool valid = argc == 3 || (argc == 5 && std::string(argv[3]) == "--reorder" &&
+                             ParseVertexOrder(argv[4], order));
+  if (!valid) {
+    std::cerr << "Usage: ./convert <data graph file> <snapshot file> "
+                 "[--reorder input|label|bfs]\n";
+    return EXIT_FAILURE;
+  }
+
+  std::string data_file_name = argv[1];
+  std::string snapshot_file_name = argv[2];
+
+  try {
+    // the snapshot keeps the order, and the ids of the file for the boundary
+    Graph data(data_file_name, false, false, order);
+
+    if (!data.SaveSnapshot(snapshot_file_name)) {
+      std::cerr << "Cannot write snapshot " << snapshot_file_name << "\n";
+      return EXIT_FAILURE;
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,28 @@
+/**
+ * @file decode.cc
+ * @brief prints a binary embedding file in the text format
+ *
+ */
+
+#include <unistd.h>
+
+#include "common.h"
+#include "embedding_writer.h"
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    std::cerr << "Usage: ./decode <binary embedding file>\n";
+    return EXIT_FAILURE;
+  }
+
+  std::string embedding_file_name = argv[1];
+
+  EmbeddingWriter out(STDOUT_FILENO, kTextOutput);
+
+  if (!DecodeEmbeddings(embedding_file_name, out)) {
+    std::cerr << "Cannot decode " << embedding_file_name << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
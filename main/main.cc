@@ -8,44 +8,196 @@
 #include "common.h"
 #include "graph.h"
 #include "dag.h"
+#include "embedding_writer.h"
+#include "matching_order.h"
+#include "query_setup.h"
+#include "server.h"
+#include <signal.h>
 #include <stdio.h>
-int main(int argc, char* argv[]) {
- if (argc < 4) {
+#include <unistd.h>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+/*search that SIGTERM checkpoints and stops, nullptr if the search has no
+checkpoint file*/
+Backtrack *checkpointed_search = nullptr;
+
+void OnTerminate(int) {
+  if (checkpointed_search != nullptr) checkpointed_search->RequestCheckpoint();
+}
+
+/*embeddings are printed up to the limit of the original program, and counted
+without limit*/
+size_t DefaultLimit(MatchMode mode) {
+  return mode == kPrintMatches ? Backtrack::kDefaultLimit : Backtrack::kNoLimit;
+}
+
+/*./program --server <data graph file> [--socket <path>] [--jobs <n>] [--threads <n>] [--order <order>] [--format <format>]
+  [--mode <mode>] [--limit <n>] [--dense-labels] [--reorder <order>] [--verify]
+  [--time-limit <seconds>] [--symmetry]*/
+int ServerMain(int argc, char* argv[]) {
+  ServerOptions options;
+  options.num_jobs = std::max(1u, std::thread::hardware_concurrency());
+  SearchOptions &search = options.search;
+
+  std::string option;
+  try {
+    for (int i = 3; i < argc; ++i) {
+      option = argv[i];
+      if (ParseSearchOption(argc, argv, i, search)) continue;
+      if (option == "--socket" && i + 1 < argc) {
+        options.socket_path = argv[++i];
+      } else if (option == "--jobs" && i + 1 < argc) {
+        options.num_jobs = std::stoul(argv[++i]);
+      } else {
+        std::cerr << "Unknown option " << option << "\n";
+        return EXIT_FAILURE;
+      }
+    }
+  } catch (const std::exception &) {
+    // std::stoul and std::stod throw on values that are not numbers
+    std::cerr << "Invalid value for " << option << "\n";
+    return EXIT_FAILURE;
+  }
+
+  if (!search.limit_given) search.limit = DefaultLimit(search.mode);
+
+  Graph data(argv[2], false, search.dense_labels, search.vertex_order);
+  if (search.verify) data.BuildEdgeIndex();
+  return RunServer(data, options);
+}
+
+int Main(int argc, char* argv[]) {
+ if (argc >= 3 && std::string(argv[1]) == "--server") return ServerMain(argc, argv);
+
+ if (argc < 3) {
     std::cerr << "Usage: ./program <data graph file> <query graph file> "
-                 "<candidate set file>\n";
+                 "[<candidate set file>] [--threads <n>]\n"
+                 "                 [--order candidate|path|gql|ri] "
+                 "[--format text|binary]\n"
+                 "                 [--mode print|count|exists] [--limit <n>] "
+                 "[--dense-labels]\n"
+                 "                 [--reorder input|label|bfs] [--verify] "
+                 "[--stats] [--progress <seconds>]\n"
+                 "                 [--time-limit <seconds>] [--checkpoint <file>] "
+                 "[--checkpoint-interval <seconds>]\n"
+                 "                 [--resume <file>] [--symmetry]\n"
+                 "       ./program --server <data graph file> [--socket <path>] "
+                 "[--jobs <n>] [--threads <n>]\n"
+                 "                 [--order candidate|path|gql|ri] "
+                 "[--format text|binary]\n"
+                 "                 [--mode print|count|exists] [--limit <n>] "
+                 "[--dense-labels]\n"
+                 "                 [--reorder input|label|bfs] [--verify] "
+                 "[--time-limit <seconds>] [--symmetry]\n";
     return EXIT_FAILURE;
  }
 
   std::string data_file_name = argv[1];
   std::string query_file_name = argv[2];
-  std::string candidate_set_file_name = argv[3];
-
-  Graph data(data_file_name);
-  //printf("Graph ");
-  CandidateSet candidate_set(candidate_set_file_name);
-  //printf("Candidate ");
-  Dag query(query_file_name, candidate_set, true);
-//  std::cout<<query.GetNumEdges()<<std::endl;
-//  std::cout<<"root "<<query.root<<std::endl;
-//  for(int i=0; i<query.dag_adj.size(); i++){
-//      std::cout<<"for "<<i<<std::endl;
-//      for(size_t j=0; j<query.GetParentSize(i); j++) {
-//          std::cout<<query.GetParent(i, j)<<" ";
-//      }
-//      std::cout<<std::endl;
-//  }
-//  for(int i=0; i<query.dag_adj.size(); i++){
-//      std::cout<<"for "<<i<<std::endl;
-//      for(size_t j=0; j<query.GetChildSize(i); j++) {
-//          std::cout << query.GetChild(i,j) << " ";
-//      }
-//      std::cout<<std::endl;
-//  }
-
-  
-  Backtrack backtrack(data, query, candidate_set);
-
-  backtrack.PrintAllMatches();
+  // without a candidate set file (or with "-"), candidates are filtered here
+  std::string candidate_set_file_name = "-";
+  int first_option = 3;
+  if (argc > 3 && std::string(argv[3]).compare(0, 2, "--") != 0)
+    candidate_set_file_name = argv[first_option++];
 
+  SearchOptions search;
+  bool print_stats = false;
+  double progress_interval = 0;
+  std::string checkpoint_file_name;
+  double checkpoint_interval = 600;
+  std::string resume_file_name;
+  std::string option;
+  try {
+    for (int i = first_option; i < argc; ++i) {
+      option = argv[i];
+      if (ParseSearchOption(argc, argv, i, search)) continue;
+      if (option == "--stats") {
+        print_stats = true;
+      } else if (option == "--progress" && i + 1 < argc) {
+        progress_interval = std::stod(argv[++i]);
+      } else if (option == "--checkpoint" && i + 1 < argc) {
+        checkpoint_file_name = argv[++i];
+      } else if (option == "--checkpoint-interval" && i + 1 < argc) {
+        checkpoint_interval = std::stod(argv[++i]);
+      } else if (option == "--resume" && i + 1 < argc) {
+        resume_file_name = argv[++i];
+      } else {
+        std::cerr << "Unknown option " << option << "\n";
+        return EXIT_FAILURE;
+      }
+    }
+  } catch (const std::exception &) {
+    std::cerr << "Invalid value for " << option << "\n";
+    return EXIT_FAILURE;
+  }
+  // the frontier of a search is the stack of its only worker
+  if ((!checkpoint_file_name.empty() || !resume_file_name.empty()) &&
+      search.num_threads > 1) {
+    std::cerr << "--checkpoint and --resume need --threads 1\n";
+    return EXIT_FAILURE;
+  }
+
+  Graph data(data_file_name, false, search.dense_labels, search.vertex_order);
+  // verification tests every edge of every embedding
+  if (search.verify) data.BuildEdgeIndex();
+  PreparedQuery prepared =
+      PrepareQuery(data, query_file_name, candidate_set_file_name);
+
+  if (!search.limit_given) search.limit = DefaultLimit(search.mode);
+
+  EmbeddingWriter out(STDOUT_FILENO, search.format);
+  Backtrack backtrack(data, *prepared.dag, *prepared.candidate_set,
+                      search.num_threads, &out, search.order);
+  backtrack.SetVerification(search.verify);
+  backtrack.SetProgressInterval(progress_interval);
+  backtrack.SetTimeLimit(search.time_limit);
+  backtrack.SetSymmetryBreaking(search.symmetry);
+  if (!resume_file_name.empty() && !backtrack.ResumeFrom(resume_file_name))
+    return EXIT_FAILURE;
+  if (!checkpoint_file_name.empty()) {
+    backtrack.SetCheckpoint(checkpoint_file_name, checkpoint_interval);
+    checkpointed_search = &backtrack;
+    signal(SIGTERM, OnTerminate);
+  }
+
+  if (search.mode == kPrintMatches)
+    backtrack.PrintAllMatches(search.limit);
+  else if (search.mode == kCountMatches)
+    printf("%zu\n", backtrack.CountMatches(search.limit));
+  else
+    printf("%d\n", backtrack.HasMatch() ? 1 : 0);
+  checkpointed_search = nullptr;
+
+  if (print_stats) std::cerr << backtrack.GetStats().ToString();
+
+  // the embeddings found until the time limit or SIGTERM are written, but
+  // not all of them
+  if (backtrack.IsTruncated()) {
+    std::cerr << "truncated: " << backtrack.GetNumEmbeddings()
+              << " embeddings, " << backtrack.GetNumRootCandidatesStarted()
+              << " of " << backtrack.GetNumRootCandidates()
+              << " root candidates\n";
+    if (!checkpoint_file_name.empty())
+      std::cerr << "resume with --resume " << checkpoint_file_name << "\n";
+  }
+
+  if (backtrack.GetNumInvalidEmbeddings() > 0) {
+    std::cerr << backtrack.GetNumInvalidEmbeddings()
+              << " embeddings failed verification\n";
+    return EXIT_FAILURE;
+  }
   return EXIT_SUCCESS;
 }
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  // the loaders throw std::runtime_error on a missing or malformed file
+  try {
+    return Main(argc, argv);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+}
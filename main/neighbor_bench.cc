@@ -0,0 +1,105 @@
+/**
+ * @file neighbor_bench.cc
+ * @brief compares edge tests by binary search with the edge index
+ *
+ */
+
+#include <chrono>
+#include <random>
+
+#include "common.h"
+#include "graph.h"
+
+namespace {
+
+/*half of the pairs are edges, from a uniformly chosen vertex, so that hubs
+are tested as often as they are in a search, and half are random pairs*/
+std::vector<std::pair<Vertex, Vertex>> SamplePairs(const Graph &data,
+                                                   size_t num_pairs) {
+  std::mt19937_64 random(42);
+  std::uniform_int_distribution<Vertex> vertex(0, data.GetNumVertices() - 1);
+  std::vector<std::pair<Vertex, Vertex>> pairs;
+  pairs.reserve(num_pairs);
+  while (pairs.size() < num_pairs) {
+    Vertex u = vertex(random);
+    if (pairs.size() % 2 == 0) {
+      if (data.GetDegree(u) == 0) continue;
+      size_t j = data.GetNeighborStartOffset(u) + random() % data.GetDegree(u);
+      pairs.push_back(std::make_pair(u, data.GetNeighbor(j)));
+    } else {
+      pairs.push_back(std::make_pair(u, vertex(random)));
+    }
+  }
+  return pairs;
+}
+
+/*tests every pair, and returns the # of edges and the ns per test*/
+std::pair<size_t, double> Run(const Graph &data,
+                              const std::vector<std::pair<Vertex, Vertex>> &pairs,
+                              int rounds) {
+  size_t edges = 0;
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; ++r)
+    for (const std::pair<Vertex, Vertex> &p : pairs)
+      edges += data.IsNeighbor(p.first, p.second);
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return std::make_pair(edges / rounds,
+                        elapsed.count() / (pairs.size() * rounds));
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    std::cerr << "Usage: ./neighbor_bench <data graph file> [<# of pairs>] "
+                 "[<# of rounds>]\n";
+    return EXIT_FAILURE;
+  }
+
+  std::unique_ptr<Graph> loaded;
+  size_t num_pairs;
+  int rounds;
+  try {
+    loaded.reset(new Graph(argv[1]));
+    num_pairs = argc > 2 ? std::stoul(argv[2]) : 1000000;
+    rounds = argc > 3 ? std::stoi(argv[3]) : 10;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+  Graph &data = *loaded;
+
+  std::vector<std::pair<Vertex, Vertex>> pairs = SamplePairs(data, num_pairs);
+
+  std::pair<size_t, double> search = Run(data, pairs, rounds);
+  // the result of every pair, which the edge index must reproduce
+  std::vector<bool> is_edge(pairs.size());
+  for (size_t i = 0; i < pairs.size(); ++i)
+    is_edge[i] = data.IsNeighbor(pairs[i].first, pairs[i].second);
+
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  data.BuildEdgeIndex();
+  std::chrono::duration<double, std::milli> build =
+      std::chrono::steady_clock::now() - start;
+
+  std::pair<size_t, double> index = Run(data, pairs, rounds);
+
+  printf("pairs %zu edges %zu\n", pairs.size(), search.first);
+  printf("binary search: %.2f ns per test\n", search.second);
+  printf("edge index:    %.2f ns per test, built in %.1f ms, %.1f MB\n",
+         index.second, build.count(),
+         data.GetEdgeIndex().GetMemorySize() / 1048576.0);
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    Vertex u = pairs[i].first, v = pairs[i].second;
+    if (data.GetEdgeIndex().Contains(u, v) != is_edge[i]) {
+      std::cerr << "edge index disagrees on (" << u << ", " << v
+                << "): binary search " << (is_edge[i] ? "finds" : "misses")
+                << " the edge\n";
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
@@ -4,54 +4,492 @@
  */
 
 #include "backtrack.h"
+#include "intersection.h"
+#include <algorithm>
+#include <condition_variable>
 #include <queue>
 #include <stdio.h>
+#include <thread>
+#include <unistd.h>
 using namespace std;
 
 
-Backtrack::Backtrack(const Graph &d, const Dag &q, const CandidateSet &c): data(d), query(q), cs(c){
-  
+Backtrack::Backtrack(const Graph &d, const Dag &q, const CandidateSet &c, size_t num_threads, EmbeddingWriter *out, OrderType order_type): data(d), query(q), cs(c), space(d, q, c), order(q, c, space, order_type), num_threads(num_threads), out(out){
+
+  if(out==nullptr){
+    stdout_writer.reset(new EmbeddingWriter(STDOUT_FILENO, kTextOutput));
+    this->out = stdout_writer.get();
+  }
+
   cnt = 0;
+  limit = kNoLimit;
+  callback = nullptr;
+  halted = false;
+  cancelled = false;
+  cancel_requested = false;
+  time_limit = 0;
+  watch_clock = false;
+  checkpoint_interval = 0;
+  checkpoint_requested = false;
+  verify = false;
+  symmetry = false;
+  symmetry_factor = 1;
+  num_invalid = 0;
+  progress_interval = 0;
+  roots_started = 0;
   q_size = query.GetNumVertices();
-  embedding = vector<Vertex>(q_size, -1);  
-  embedding_size = 0;  
-  pair<size_t, vector<Vertex>> init = make_pair(0, vector<Vertex>());
-  extendable = vector<pair<size_t,vector<Vertex>>>(q_size, init);
+  reported = vector<Vertex>(q_size);
 
   embedding_list = vector<vector<Vertex>>();
 
   root = query.GetRoot();
+  pool = nullptr;
+
+  is_leaf = vector<bool>(q_size, false);
+  for(size_t u=0; u<q_size&&q_size>1; u++){
+    if((Vertex)u!=root&&query.GetParentSize(u)+query.GetChildSize(u)==1){
+      is_leaf[u] = true;
+      leaves.push_back(u);
+    }
+  }
+  stable_sort(leaves.begin(), leaves.end(), [this](Vertex a, Vertex b){
+    return query.GetLabel(a)<query.GetLabel(b);
+  });
+  postpone_leaves = false;
 }
 Backtrack::~Backtrack() {}
 
-void Backtrack::PrintAllMatches() {
-  printf("t %lu\n", query.GetNumVertices());
-  // implement your code here.
-  backtrack(root); 
-  
+/*# of embeddings found by the last search, at most its limit*/
+size_t Backtrack::GetNumEmbeddings() const {
+  return min(cnt.load(), limit);
 }
 
-void  Backtrack::printembedding(){
- 
-  /*for checking*/
-  //if(check()!=0) printf("wrong embedding: %d    ", check());
-  printf("a ");
+/*checks every reported embedding against the query and the data graph
+(labels, injectivity and edges) and drops the wrong ones. the query tests
+edges with its adjacency matrix, and the data graph with its edge index if it
+is built (see Graph::BuildEdgeIndex)*/
+void Backtrack::SetVerification(bool verify) {
+  this->verify = verify;
+}
+
+/*# of embeddings of the last search that failed verification*/
+size_t Backtrack::GetNumInvalidEmbeddings() const {
+  return num_invalid;
+}
+
+/*print "progress <s> s: <n> embeddings, root candidate <i> of <n>" on stderr
+every seconds during a search, 0 for never*/
+void Backtrack::SetProgressInterval(double seconds) {
+  progress_interval = seconds;
+}
+
+/*search only the embeddings that map every class of equivalent query vertices (see Dag::GetEquivalenceClass)
+in increasing order of the data vertices, and count or print the permutations of each class from them.
+the search space shrinks by up to the product of the factorials of the class sizes; printed embeddings
+are the same, in another order*/
+void Backtrack::SetSymmetryBreaking(bool enable) {
+  symmetry = enable;
+}
+
+/*the classes of equivalent vertices that the next search orders, and the # of embeddings each embedding
+it finds stands for. leaves counted by count_leaves are never mapped one by one, so their classes are not
+ordered*/
+void Backtrack::set_up_symmetry(){
+  classes.clear();
+  equivalent.assign(q_size, vector<Vertex>());
+  symmetry_factor = 1;
+  if(!symmetry) return;
+
+  vector<vector<Vertex>> members(q_size);
+  for(size_t u=0; u<q_size; u++) members[query.GetEquivalenceClass(u)].push_back(u);
+  for(const vector<Vertex> &m: members){
+    if(m.size()<2) continue;
+    if(postpone_leaves&&any_of(m.begin(), m.end(), [this](Vertex u){ return (bool)is_leaf[u]; })) continue;
+    classes.push_back(m);
+    for(Vertex u: m)
+      for(Vertex w: m) if(w!=u) equivalent[u].push_back(w);
+    for(size_t k=2; k<=m.size(); k++)
+      symmetry_factor = (symmetry_factor>SIZE_MAX/k) ? SIZE_MAX : symmetry_factor*k;
+  }
+}
+
+/*the next embedding in the permutations of the classes, as an odometer: permute the data vertices of the
+last class, and when they are back in increasing order, those of the class before it*/
+void Backtrack::next_symmetric(vector<Vertex> &embedding){
+  for(size_t c=classes.size(); c-->0;){
+    permuted.clear();
+    for(Vertex u: classes[c]) permuted.push_back(embedding[u]);
+    bool more = next_permutation(permuted.begin(), permuted.end());
+    for(size_t k=0; k<classes[c].size(); k++) embedding[classes[c][k]] = permuted[k];
+    if(more) return;
+  }
+}
+
+/*counters of the last search, merged over the workers. they are only
+counted if the build defines ENABLE_STATS (see search_stats.h)*/
+const SearchStats &Backtrack::GetStats() const {
+  return stats;
+}
+
+void Backtrack::print_progress(){
+  chrono::duration<double> elapsed = chrono::steady_clock::now()-search_start;
+  fprintf(stderr, "progress %.1f s: %zu embeddings, root candidate %zu of %zu\n",
+          elapsed.count(), GetNumEmbeddings(), GetNumRootCandidatesStarted(),
+          GetNumRootCandidates());
+}
+
+/*stops every search after seconds, keeping the embeddings found until then
+(see IsTruncated). 0 for no limit*/
+void Backtrack::SetTimeLimit(double seconds) {
+  time_limit = seconds;
+}
+
+/*stops the running search as soon as every worker notices, within
+kClockCheckInterval search nodes, or the next search when it starts. may be
+called from any thread, before or during the search; every later search is
+cancelled as well*/
+void Backtrack::Cancel() {
+  cancel_requested = true;
+  cancelled = true;
+}
+
+/*true if the last search was cancelled or ran out of time before it
+finished, so that its embeddings are only some of them*/
+bool Backtrack::IsTruncated() const {
+  return cancelled;
+}
+
+/*how far the last search got: # of candidates of the root whose subtree was
+entered, out of GetNumRootCandidates()*/
+size_t Backtrack::GetNumRootCandidatesStarted() const {
+  return min(roots_started.load(), GetNumRootCandidates());
+}
+
+size_t Backtrack::GetNumRootCandidates() const {
+  return cs.GetCandidateSize(root);
+}
+
+/*looks at the clock once in kClockCheckInterval calls: writes the checkpoint when it is due, and cancels the
+search once it is past the deadline or a checkpoint was requested. st is then at the top of its frame loop,
+which is where a resumed search starts again*/
+void Backtrack::check_clock(SearchState &st){
+  st.nodes_until_check = kClockCheckInterval;
+  chrono::steady_clock::time_point now = chrono::steady_clock::now();
+  bool stop = (time_limit>0&&now>=deadline)||checkpoint_requested.load(memory_order_relaxed);
+
+  /*only a single worker has the whole frontier in its stack*/
+  if(!checkpoint_file.empty()&&pool==nullptr&&(stop||(checkpoint_interval>0&&now>=next_checkpoint))){
+    if(!save_checkpoint(st)) fprintf(stderr, "cannot write checkpoint %s\n", checkpoint_file.c_str());
+    next_checkpoint = now+chrono::duration_cast<chrono::steady_clock::duration>(
+        chrono::duration<double>(checkpoint_interval));
+  }
+  if(!stop) return;
+  cancelled = true;
+  if(pool!=nullptr) pool->Stop();
+}
+
+/*time of the first embedding the worker finds, relative to the start of the search*/
+void Backtrack::note_embedding(SearchState &st){
+  if(st.stats.first_embedding_ms>=0) return;
+  chrono::duration<double, milli> elapsed = chrono::steady_clock::now()-search_start;
+  st.stats.first_embedding_ms = elapsed.count();
+}
+
+/**
+ * @brief Parses the name of a mode given on the command line: print, count or
+ * exists.
+ *
+ * @param name
+ * @param mode output.
+ * @return bool false if the name is unknown.
+ */
+bool ParseMatchMode(const std::string &name, MatchMode &mode){
+  if(name=="print") mode = kPrintMatches;
+  else if(name=="count") mode = kCountMatches;
+  else if(name=="exists") mode = kExistsMatch;
+  else return false;
+  return true;
+}
+
+void Backtrack::init_state(SearchState &st){
+  st.embedding = vector<Vertex>(q_size, -1);
+  st.embedding_index = vector<uint32_t>(q_size, 0);
+  st.mapped_by = vector<Vertex>(data.GetNumVertices(), -1);
+  st.embedding_size = 0;
+  st.extendable = vector<uint32_t>(cs.GetNumCandidates());
+  st.extendable_size = vector<uint32_t>(q_size, 0);
+  st.is_extendable = vector<bool>(q_size, false);
+  st.heap = VertexHeap(q_size);
+  st.key = vector<double>(q_size, 0);
+  /*a path maps every vertex at most once, so these never grow during the search*/
+  st.undo_log.clear();
+  st.undo_log.reserve(q_size);
+  st.undo_mark.clear();
+  st.undo_mark.reserve(q_size);
+  st.mapped.clear();
+  st.mapped.reserve(q_size);
+  st.failing_sets = vector<VertexSet>(q_size+1, VertexSet(q_size));
+  st.frames.clear();
+  st.frames.reserve(q_size);
+  st.stats.Reset(q_size);
+  st.nodes_until_check = kClockCheckInterval;
+
+  size_t num_leaf_candidates = 0;
+  for(Vertex leaf: leaves) num_leaf_candidates += cs.GetCandidateSize(leaf);
+  st.leaf_candidates.clear();
+  st.leaf_candidates.reserve(num_leaf_candidates);
+  st.leaf_offset = vector<size_t>(leaves.size()+1, 0);
+}
+
+/*writes the header and the first limit embeddings to the writer of the constructor*/
+void Backtrack::PrintAllMatches(size_t limit) {
+  /*a resumed search prints the header again, and then only the embeddings after the checkpoint*/
+  out->WriteHeader(query.GetNumVertices());
+
+  MatchCallback print = [this](const Vertex *embedding, size_t size){
+    out->Write(embedding, size);
+    return true;
+  };
+  search(&print, limit);
+  out->Flush();
+}
+
+/*counts the embeddings, up to limit, without materializing them*/
+size_t Backtrack::CountMatches(size_t limit) {
+  search(nullptr, limit);
+  return GetNumEmbeddings();
+}
+
+/*true if the query has an embedding; the search stops at the first one*/
+bool Backtrack::HasMatch() {
+  return CountMatches(1)>0;
+}
+
+/*calls callback with every embedding, up to limit, until it returns false.
+returns the # of embeddings given to callback*/
+size_t Backtrack::EnumerateMatches(const MatchCallback &callback, size_t limit) {
+  search(&callback, limit);
+  return GetNumEmbeddings();
+}
+
+void Backtrack::search(const MatchCallback *callback, size_t limit) {
+  this->callback = callback;
+  this->limit = limit;
+  cnt = 0;
+  halted = false;
+  /*cleared before cancel_requested is read, so that a concurrent Cancel is not lost*/
+  cancelled = false;
+  if(cancel_requested) cancelled = true;
+  num_invalid = 0;
+  /*only full enumeration has to map the leaves one by one*/
+  postpone_leaves = callback==nullptr&&!leaves.empty();
+  set_up_symmetry();
+
+  roots_started = 0;
+  stats.Reset(q_size);
+  search_start = chrono::steady_clock::now();
+  deadline = search_start+chrono::duration_cast<chrono::steady_clock::duration>(
+      chrono::duration<double>(time_limit));
+  next_checkpoint = search_start+chrono::duration_cast<chrono::steady_clock::duration>(
+      chrono::duration<double>(checkpoint_interval));
+  watch_clock = time_limit>0||!checkpoint_file.empty();
+
+  /*a checkpoint that does not fit this search throws, before anything runs, so that the caller decides
+  what to do with the error*/
+  bool resuming = !resume.frames.empty();
+  if(resuming){
+    if(resume.enumerate!=(callback!=nullptr))
+      throw runtime_error(string("Checkpoint was taken by a search that ")+
+                          (resume.enumerate ? "enumerates" : "counts")+" the embeddings");
+    if(resume.symmetry!=symmetry)
+      throw runtime_error(string("Checkpoint was taken by a search ")+
+                          (resume.symmetry ? "with" : "without")+" symmetry breaking");
+  }
+
+  vector<uint32_t> root_candidates;
+  for(size_t i=0; i<cs.GetCandidateSize(root); i++) root_candidates.push_back(i);
+
+  /*the stack of the checkpoint is rebuilt before the progress thread starts. only a single-threaded
+  search resumes (see ResumeFrom)*/
+  SearchState resumed;
+  if(resuming){
+    init_state(resumed);
+    if(!restore_checkpoint(resumed, root_candidates.data(), root_candidates.size()))
+      throw runtime_error("Checkpoint does not match the query, the candidate set or the matching order");
+    resume.frames.clear();
+    cnt = resume.count;
+    roots_started = resume.roots_started;
+  }
+
+  /*the progress line is printed by a thread of its own until the search returns*/
+  mutex progress_lock;
+  condition_variable progress_done;
+  bool done = false;
+  thread progress;
+  if(progress_interval>0){
+    progress = thread([&](){
+      unique_lock<mutex> guard(progress_lock);
+      chrono::duration<double> interval(progress_interval);
+      while(!progress_done.wait_for(guard, interval, [&](){ return done; })) print_progress();
+    });
+  }
+
+  if(resuming){
+    run_frames(resumed, 0, 0);
+    /*the frames below the checkpoint were mapped by restore_checkpoint*/
+    while(!resumed.mapped.empty()) unmap_vertex(resumed, resumed.mapped.back().first);
+    stats.Merge(resumed.stats);
+  }
+  else if(num_threads<=1){
+    SearchState st;
+    init_state(st);
+    backtrack(st, 0, root, root_candidates.data(), root_candidates.size());
+    stats.Merge(st.stats);
+  }
+  else{
+    /*every root candidate is a task at first, skewed subtrees are split further
+    by the workers themselves when another worker runs out of work*/
+    WorkStealingPool workers(num_threads);
+    vector<SearchState> states(num_threads);
+    for(SearchState &st: states) init_state(st);
+
+    for(size_t i=0; i<root_candidates.size(); i++){
+      SearchTask task;
+      task.next = root;
+      task.candidates.push_back(root_candidates[i]);
+      workers.Push(i%num_threads, std::move(task));
+    }
+
+    pool = &workers;
+    workers.Run([this, &states](size_t worker, SearchTask &task){
+      run_task(states[worker], worker, task);
+    });
+    pool = nullptr;
+    for(const SearchState &st: states) stats.Merge(st.stats);
+  }
+
+  if(progress.joinable()){
+    {
+      lock_guard<mutex> guard(progress_lock);
+      done = true;
+    }
+    progress_done.notify_one();
+    progress.join();
+  }
+
+  /*the checkpoint of a search that finished would resume its tail again*/
+  if(!checkpoint_file.empty()&&!cancelled) remove(checkpoint_file.c_str());
+}
+
+/*replay the prefix of the task on a clean state, search its subtree and clean the state up again*/
+void Backtrack::run_task(SearchState &st, size_t worker, SearchTask &task){
+  for(const pair<Vertex, uint32_t> &m: task.prefix) map_vertex(st, m.first, m.second);
+
+  backtrack(st, worker, task.next, task.candidates.data(), task.candidates.size());
+
+  while(!st.mapped.empty()) unmap_vertex(st, st.mapped.back().first);
+}
+
+/*add u -> (index-th candidate of u) to the partial embedding, and extend the children of u*/
+void Backtrack::map_vertex(SearchState &st, Vertex u, uint32_t index){
+  Vertex v = cs.GetCandidate(u, index);
+  st.embedding[u] = v;
+  st.embedding_index[u] = index;
+  st.mapped_by[v] = u;
+  st.embedding_size++;
+  st.mapped.push_back(make_pair(u, index));
+  st.heap.Remove(u);
+
+  st.undo_mark.push_back(st.undo_log.size());
+  update_extendable(st, u);
+}
+
+/*remove u, the vertex mapped last, from the partial embedding.
+the vertices that became extendable when u was mapped are not extendable any more*/
+void Backtrack::unmap_vertex(SearchState &st, Vertex u){
+  size_t mark = st.undo_mark.back();
+  st.undo_mark.pop_back();
+  while(st.undo_log.size()>mark){
+    Vertex child = st.undo_log.back();
+    st.undo_log.pop_back();
+    st.is_extendable[child] = false;
+    st.extendable_size[child] = 0;
+    st.heap.Remove(child);
+  }
+
+  st.mapped_by[st.embedding[u]] = -1;
+  st.embedding[u] = -1;
+  st.embedding_size--;
+  st.mapped.pop_back();
+  if(st.is_extendable[u]) st.heap.Push(u, st.key[u]);
+}
+
+/*hand the untried candidates of the shallowest running loop, which is the
+largest piece of work left, to an idle worker*/
+void Backtrack::split(SearchState &st, size_t worker){
+  for(SearchState::Frame &frame: st.frames){
+    if(frame.next_index>=frame.size) continue;
+
+    SearchTask task;
+    task.prefix.assign(st.mapped.begin(), st.mapped.begin()+frame.depth);
+    task.next = frame.curr;
+    task.candidates.assign(frame.candidates+frame.next_index, frame.candidates+frame.size);
+    frame.size = frame.next_index;
+    frame.donated = true;
+
+    pool->Push(worker, std::move(task));
+    return;
+  }
+}
+
+/*true unless verification is on and the embedding of st fails the check, in which case it and its n-1
+symmetric images are counted as invalid. a symmetric image is correct whenever the embedding is*/
+bool Backtrack::verified(const SearchState &st, size_t n){
+  if(!verify) return true;
+  unique_lock<mutex> guard(print_lock, defer_lock);
+  if(pool!=nullptr) guard.lock();
+  if(check(st)==kCorrect) return true;
+  num_invalid += n;
+  return false;
+}
+
+/*report the embedding of st, and then its images under the permutations of the equivalent vertices,
+n embeddings in total*/
+void  Backtrack::report_embedding(const SearchState &st, size_t n){
+
+  /*workers report whole embeddings one at a time*/
+  unique_lock<mutex> guard(print_lock, defer_lock);
+  if(pool!=nullptr) guard.lock();
+
+  const Vertex *embedding = st.embedding.data();
+  if(n>1){
+    expanded.assign(st.embedding.begin(), st.embedding.end());
+    embedding = expanded.data();
+  }
+  for(size_t k=0; k<n&&!halted; k++){
+    if(k>0) next_symmetric(expanded);
+    /*callers see the ids of the data graph file*/
+    const Vertex *original = embedding;
+    if(data.IsReordered()){
+      for(size_t u=0; u<q_size; u++) reported[u] = data.GetOriginalId(embedding[u]);
+      original = reported.data();
+    }
+    if(!(*callback)(original, q_size)){
+      halted = true;
+      if(pool!=nullptr) pool->Stop();
+    }
+  }
 
-  for(size_t i=0; i<q_size; i++){
-    printf("%d ", embedding[i]);
-  }  
-  printf("\n");
-  
   /*for checking repetition*/
-  /*if(check_replica()){
+  /*if(check_replica(st)){
     printf("a ");
 
     for(size_t i=0; i<q_size; i++){
-     printf("%d ", embedding[i]);
-    }  
+     printf("%d ", st.embedding[i]);
+    }
     printf("\n");
 
-    vector<Vertex> curr_embedding(embedding);
+    vector<Vertex> curr_embedding(st.embedding);
     embedding_list.push_back(curr_embedding);
   }
   else printf("repeated\n");
@@ -59,12 +497,12 @@ void  Backtrack::printembedding(){
 
 }
 
-bool Backtrack::check_replica(){  
+bool Backtrack::check_replica(const SearchState &st){
 
   for(vector<Vertex> past_embedding: embedding_list){
       size_t same_cnt = 0;
       for(size_t i=0; i<q_size; i++){
-        if(past_embedding[i]==embedding[i]) same_cnt++;
+        if(past_embedding[i]==st.embedding[i]) same_cnt++;
       }
 
       if(same_cnt==q_size) return false;
@@ -75,194 +513,333 @@ bool Backtrack::check_replica(){
 
 }
 
-int Backtrack::check(){
+/*O(|Vq| log |Vq| + |Eq|) per embedding, so that it can check every one. called under print_lock*/
+Backtrack::CheckResult Backtrack::check(const SearchState &st){
   for(size_t i=0; i<q_size; i++){
     /*check condition 2: same label*/
-    if(query.GetLabel(i)!=data.GetLabel(embedding[i])) return 2;
-
-    for(size_t j=i+1; j<q_size; j++){
-      /*check condition 1: injectivity*/
-      if(embedding[i]==embedding[j]) return embedding[i];
+    if(query.GetLabel(i)!=data.GetLabel(st.embedding[i])) return kWrongLabel;
 
-      /*check condition 3: edges*/
-      if(query.IsNeighbor(i,j)) if(!data.IsNeighbor(embedding[i], embedding[j])) return 3;
-    }
+    /*check condition 3: edges, each one from its parent in the DAG*/
+    for(size_t j=0; j<query.GetChildSize(i); j++)
+      if(!data.IsNeighbor(st.embedding[i], st.embedding[query.GetChild(i, j)])) return kMissingEdge;
   }
-  return 0;
-}
-
-void Backtrack::backtrack(Vertex curr){
-  size_t curr_cs_size; /*candidate space size for curr vertex*/
 
-  curr_cs_size = cs.GetCandidateSize(curr);
+  /*check condition 1: injectivity. any data vertex, 0 included, may be the repeated one*/
+  checked.assign(st.embedding.begin(), st.embedding.end());
+  sort(checked.begin(), checked.end());
+  if(adjacent_find(checked.begin(), checked.end())!=checked.end()) return kNotInjective;
+  return kCorrect;
+}
 
-  if(curr==root){
-      /*map curr vertex to candidate space*/
-      for(size_t i =0; i<curr_cs_size; i++){
-        Vertex curr_cs = cs.GetCandidate(curr, i); /*candidate for mapping*/
+/*search every candidate of curr, and compute the failing set of the search node before mapping curr:
+a set of query vertices such that the node fails again whenever the mapping of these vertices is the same.
+an empty failing set means that the node has an embedding (or it is unknown), so nothing can be pruned.
+the search is iterative: st.frames is the stack of the candidate loops from curr down to the deepest
+mapped vertex, and st.failing_sets[d] is the failing set of the node of the d-th frame*/
+void Backtrack::backtrack(SearchState &st, size_t worker, Vertex curr, const uint32_t *curr_candidates, size_t curr_size){
+  size_t base = st.frames.size();
+  push_frame(st, curr, curr_candidates, curr_size);
+  run_frames(st, worker, base);
+}
 
-        /*injectivity & parent edge condition need not to be checked for root,
-        so directly map and update partial embedding*/
-        embedding[curr] = curr_cs;
-        embedding_size++;
+/*run the frames of st above base until they are all done*/
+void Backtrack::run_frames(SearchState &st, size_t worker, size_t base){
+  while(st.frames.size()>base){
+    size_t frame_id = st.frames.size()-1;
+    VertexSet &child_failing_set = st.failing_sets[frame_id+1]; /*failing set of the subtree of each candidate*/
+
+    /*back from the frame of the next vertex: the candidate tried last is mapped*/
+    if(st.frames[frame_id].descended){
+      st.frames[frame_id].descended = false;
+      unmap_vertex(st, st.frames[frame_id].curr);
+      if(!merge_failing_set(st, frame_id)){
+        pop_frame(st);
+        continue;
+      }
+    }
 
-        if(embedding_size==q_size){ /*if embedding is found*/
-          cnt++;
-          printembedding();
-          if(cnt>=100000) return;
+    /*size is re-read every time, as split() may give the tail to another worker*/
+    size_t i = st.frames[frame_id].next_index;
+    if(i<st.frames[frame_id].size&&watch_clock&&--st.nodes_until_check==0) check_clock(st);
+    if(i>=st.frames[frame_id].size||stopped()){
+      pop_frame(st);
+      continue;
+    }
 
+    st.frames[frame_id].next_index = i+1;
+    if(pool!=nullptr&&pool->IsHungry()) split(st, worker);
+
+    /*edges to the parents are already checked in update_extendable of previous level,
+    so only injectivity is left to be checked for the vertices in the candidates of the frame.
+    For the root, they are its whole candidate set.
+    They are not changed below this frame, as the parents of curr stay mapped*/
+    Vertex curr = st.frames[frame_id].curr;
+    uint32_t curr_index = st.frames[frame_id].candidates[i];
+    Vertex curr_cs = cs.GetCandidate(curr, curr_index);
+    SEARCH_STAT(st.stats.nodes_per_depth[st.embedding_size]++);
+    if(st.embedding_size==0) roots_started.fetch_add(1, memory_order_relaxed);
+
+    Vertex owner = st.mapped_by[curr_cs];
+    Vertex twin = owner==-1 ? symmetry_conflict(st, curr, curr_cs) : -1;
+    if(owner!=-1){
+      /*conflict: curr_cs is already mapped to another query vertex*/
+      SEARCH_STAT(st.stats.injectivity_conflicts++);
+      child_failing_set = query.GetAncestors(curr);
+      child_failing_set.Union(query.GetAncestors(owner));
+    }
+    else if(twin!=-1){
+      /*conflict: curr_cs is on the wrong side of the mapping of an equivalent vertex*/
+      SEARCH_STAT(st.stats.symmetry_conflicts++);
+      child_failing_set = query.GetAncestors(curr);
+      child_failing_set.Union(query.GetAncestors(twin));
+    }
+    else if(callback==nullptr&&st.embedding_size+1==q_size){
+      /*counting: curr is the last vertex, so curr_cs completes an embedding without being mapped*/
+      if(symmetry_factor==1) cnt.fetch_add(1);
+      else add_count(symmetry_factor);
+      SEARCH_STAT(note_embedding(st));
+      if(stopped()&&pool!=nullptr) pool->Stop();
+      child_failing_set.Clear();
+    }
+    else{
+      map_vertex(st, curr, curr_index); /*map and add to partial embedding*/
+
+      if(st.embedding_size==q_size){ /*if embedding is found*/
+        /*reserve a slot below the limit, so that workers never report more than limit in total. a wrong
+        embedding takes none, so that it counts neither as found nor toward the limit*/
+        if(verified(st, symmetry_factor)){
+          size_t first = symmetry_factor==1 ? cnt.fetch_add(1) : add_count(symmetry_factor);
+          if(first<limit) report_embedding(st, min(symmetry_factor, limit-first));
+          SEARCH_STAT(note_embedding(st));
         }
-        else{
-          /*Candidate-size order for bactracking*/
-
-          /*update the list of extendable vertices due to the update of partial embedding */
-          /*extendable candidates are also checked in this function*/
-          update_extendable(curr);
-
-          size_t min= SIZE_MAX;
-          int min_index=-1;
-
-          /*choose next vertex for backtracking among extendable vertices, 
-          based on candidate size order*/
-          for(size_t j=0; j<q_size; j++){
-            if(embedding[j]!=-1||extendable[j].first==0) continue;
-            else if(extendable[j].first<min){
-                min = extendable[j].first;
-                min_index = j;
-              }
-          }
-
-          if(min_index!=-1) backtrack(min_index);
-          if(cnt>=100000) return;
-        }       
-        /*in order to search other candidate for same vertex*/
-        embedding_size--;
-        embedding[curr] = -1;
-      
-             
+        if(stopped()&&pool!=nullptr) pool->Stop();
+        child_failing_set.Clear();
       }
+      else{
+        /*Candidate-size order for bactracking*/
+
+        /*the extendable vertices were updated by map_vertex*/
+        Vertex next = next_vertex(st);
+        if(next!=-1){
+          /*curr is unmapped when the frame of next is done*/
+          st.frames[frame_id].descended = true;
+          push_frame(st, next, extendable_of(st, next), st.extendable_size[next]);
+          continue;
+        }
+        else if(postpone_leaves&&st.embedding_size+leaves.size()==q_size){
+          /*only the leaves are left*/
+          size_t count = count_leaves(st, child_failing_set);
+          add_count(count>SIZE_MAX/symmetry_factor ? SIZE_MAX : count*symmetry_factor);
+          SEARCH_STAT(if(count>0) note_embedding(st));
+          if(stopped()&&pool!=nullptr) pool->Stop();
+        }
+        else child_failing_set.Clear();
+      }
+      /*in order to search other candidate for same vertex*/
+      unmap_vertex(st, curr);
+    }
 
-      return;
+    if(!merge_failing_set(st, frame_id)) pop_frame(st);
   }
-  else{
-      vector<Vertex> curr_cs_candidate = extendable[curr].second;
+}
+
+/*start the candidate loop of curr on top of the stack, with an empty failing set*/
+void Backtrack::push_frame(SearchState &st, Vertex curr, const uint32_t *curr_candidates, size_t curr_size){
+  size_t frame_id = st.frames.size();
+  SearchState::Frame frame = {curr, curr_candidates, curr_size, 0, st.embedding_size, false, false, false};
+  st.frames.push_back(frame);
+
+  VertexSet &failing_set = st.failing_sets[frame_id];
+  failing_set.Clear();
+  /*no extendable candidate: the mapping of the ancestors of curr alone makes this node fail*/
+  if(curr_size==0){
+    failing_set = query.GetAncestors(curr);
+    SEARCH_STAT(st.stats.empty_extendable++);
+  }
+}
 
-       /*checking for candidate is already done in update_extendable of previous level
-       so we can freely add every vertices in extendabe[curr].second to embedding*/
-      for(Vertex curr_cs: curr_cs_candidate){
-       
-        if(embedding.end()!=find(embedding.begin(), embedding.end(), curr_cs)) continue;
+/*end the candidate loop on top of the stack. donated subtrees and subtrees cut by the limit are not known to fail*/
+void Backtrack::pop_frame(SearchState &st){
+  size_t frame_id = st.frames.size()-1;
+  const SearchState::Frame &frame = st.frames[frame_id];
+  if(frame.found||frame.donated||stopped()) st.failing_sets[frame_id].Clear();
+  st.frames.pop_back();
+}
 
-        embedding[curr] = curr_cs; /*map and add to partial embedding*/
-        embedding_size++;
+/*add the failing set of the subtree of the candidate tried last to the one of its frame.
+returns false if the failure does not depend on the vertex of the frame, so that every other
+candidate of it fails the same way and the loop is cut short*/
+bool Backtrack::merge_failing_set(SearchState &st, size_t frame_id){
+  SearchState::Frame &frame = st.frames[frame_id];
+  VertexSet &failing_set = st.failing_sets[frame_id];
+  const VertexSet &child_failing_set = st.failing_sets[frame_id+1];
+
+  if(!child_failing_set.Empty()&&!child_failing_set.Contains(frame.curr)){
+    SEARCH_STAT(st.stats.failing_set_prunes++);
+    if(!frame.found) failing_set = child_failing_set;
+    return false;
+  }
+  if(child_failing_set.Empty()) frame.found = true; /*some subtree has an embedding*/
+  else failing_set.Union(child_failing_set);
+  return true;
+}
 
-        if(embedding_size==q_size){ /*if embedding is found*/
-          cnt++;
-          printembedding();
-          if(cnt>=100000) return;
+/*count the ways to map the leaves once every other vertex is mapped. leaves of different labels never
+share a candidate, so the count is the product of the counts of the groups of leaves with the same label.
+if a group cannot be mapped, the failing set is the ancestors of its leaves and of the vertices mapped to
+their candidates; otherwise it is empty*/
+size_t Backtrack::count_leaves(SearchState &st, VertexSet &failing_set){
+  size_t total = 1;
+  failing_set.Clear();
+
+  for(size_t first=0; first<leaves.size();){
+    size_t last = first+1;
+    while(last<leaves.size()&&query.GetLabel(leaves[last])==query.GetLabel(leaves[first])) last++;
+
+    /*extendable candidates of each leaf that are not used by a mapped vertex*/
+    st.leaf_candidates.clear();
+    for(size_t k=first; k<last; k++){
+      Vertex leaf = leaves[k];
+      const Vertex *candidates = cs.GetCandidates(leaf);
+      const uint32_t *extendable = extendable_of(st, leaf);
+      st.leaf_offset[k-first] = st.leaf_candidates.size();
+      for(size_t j=0; j<st.extendable_size[leaf]; j++){
+        Vertex v = candidates[extendable[j]];
+        if(st.mapped_by[v]==-1) st.leaf_candidates.push_back(v);
+      }
+    }
+    st.leaf_offset[last-first] = st.leaf_candidates.size();
+
+    size_t count = count_leaf_group(st, leaves.data()+first, 0, last-first);
+    if(count==0){
+      for(size_t k=first; k<last; k++){
+        Vertex leaf = leaves[k];
+        const Vertex *candidates = cs.GetCandidates(leaf);
+        const uint32_t *extendable = extendable_of(st, leaf);
+        failing_set.Union(query.GetAncestors(leaf));
+        for(size_t j=0; j<st.extendable_size[leaf]; j++){
+          Vertex owner = st.mapped_by[candidates[extendable[j]]];
+          if(owner!=-1) failing_set.Union(query.GetAncestors(owner));
         }
-        else{
-          /*same as above*/
-          update_extendable(curr);
-
-
-          size_t min= SIZE_MAX;
-          int min_index=-1;
-
-          /*check for extendable candidates, as they can be already in embedding*/
-          for(size_t j=0; j<q_size; j++){
-            if(embedding[j]!=-1||extendable[j].first==0) continue;
-            else{ 
-              size_t real_cs_size = extendable[j].first;
-
-              for(Vertex cd: extendable[j].second){
-                if(embedding.end()!=find(embedding.begin(), embedding.end(), cd)) real_cs_size--;
-              }
-              if(real_cs_size>0&&real_cs_size<min){
-                min = real_cs_size;
-                min_index = j;
-              }
-            }
-          }
-
-          if(min_index!=-1) backtrack(min_index);
-          if(cnt>=100000) return;
-        }       
-        /*in order to search other candidate for same vertex*/
-        embedding_size--;
-        embedding[curr] = -1;
       }
-
-      /*change extendable status before returning to previous stage*/
-      update_extendable(curr);
-      return;
-  }  
-  
+      return 0;
+    }
+    total = (count>limit/total) ? limit : min(total*count, limit);
+    first = last;
+  }
+  return total;
 }
-    
 
-/*check if the vertex of cs is an appropriate candidate of mapping for curr*/
-bool Backtrack::check_candidate(Vertex curr, Vertex curr_cs, const vector<Vertex> &curr_parent){   
+/*# of ways, up to limit, to map the leaves k, k+1, ..., n-1 of group to distinct usable candidates.
+a data vertex is marked in mapped_by while a leaf is mapped to it*/
+size_t Backtrack::count_leaf_group(SearchState &st, const Vertex *group, size_t k, size_t n){
+  const Vertex *first = st.leaf_candidates.data()+st.leaf_offset[k];
+  size_t size = st.leaf_offset[k+1]-st.leaf_offset[k];
 
-    /*check injectivity*/
-    if(embedding.end()!=find(embedding.begin(), embedding.end(), curr_cs)) return false;
-            
-    /*check if edges with parents exist*/
-    bool edge_exist = true;
-    for(Vertex parent: curr_parent){
-      if(embedding[parent]==-1) continue; /*parent not yet in embedding*/
-      else{
-        if(!data.IsNeighbor(embedding[parent], curr_cs)){ /*if no edge exist*/
-          edge_exist = false;
-          break;
-        }
+  if(k+1==n){
+    size_t count = 0;
+    for(size_t j=0; j<size; j++) if(st.mapped_by[first[j]]==-1) count++;
+    return count;
+  }
+
+  /*leaves with the same candidates: size*(size-1)*...*(size-n+1) ways*/
+  if(k==0){
+    bool same = true;
+    for(size_t l=1; l<n&&same; l++){
+      same = st.leaf_offset[l+1]-st.leaf_offset[l]==size&&
+             equal(first, first+size, st.leaf_candidates.data()+st.leaf_offset[l]);
+    }
+    if(same){
+      if(size<n) return 0;
+      size_t count = 1;
+      for(size_t l=0; l<n; l++){
+        if(size-l>limit/count) return limit;
+        count *= size-l;
       }
+      return min(count, limit);
     }
-    return edge_exist;
+  }
+
+  size_t count = 0;
+  for(size_t j=0; j<size&&count<limit; j++){
+    Vertex v = first[j];
+    if(st.mapped_by[v]!=-1) continue;
+    st.mapped_by[v] = group[k];
+    size_t rest = count_leaf_group(st, group, k+1, n);
+    st.mapped_by[v] = -1;
+    count = (rest>limit-count) ? limit : count+rest;
+  }
+  return count;
+}
+
+/*add n embeddings to the shared count, saturating instead of wrapping around. returns the count before*/
+size_t Backtrack::add_count(size_t n){
+  size_t old = cnt.load(memory_order_relaxed);
+  while(!cnt.compare_exchange_weak(old, (n>SIZE_MAX-old) ? SIZE_MAX : old+n)){}
+  return old;
 }
 
-void Backtrack::update_extendable(Vertex curr){
-   
+/*choose next vertex for backtracking among extendable vertices,
+the one with the smallest key in the matching order. returns -1 if there is none*/
+Vertex Backtrack::next_vertex(const SearchState &st){
+  return st.heap.Empty() ? -1 : st.heap.Top();
+}
+
+
+/*compute the extendable candidates of the children of curr that become extendable after curr is mapped,
+and log them so that unmap_vertex resets them. candidates of a child are the intersection of the
+candidate space lists of its mapped parents, written in place in the buffer of the child*/
+void Backtrack::update_extendable(SearchState &st, Vertex curr){
+   SEARCH_STAT(chrono::steady_clock::time_point start = chrono::steady_clock::now());
+   SEARCH_STAT(st.stats.update_extendable_calls++);
+
    size_t curr_child_size = query.GetChildSize(curr);
 
    for(size_t i=0; i<curr_child_size; i++){ /*check if child is extendable vertex*/
     Vertex child = query.GetChild(curr, i);
 
-    if(embedding[child]!=-1) continue;
+    if(st.embedding[child]!=-1) continue;
 
-    if(embedding[curr]==-1){
-      extendable[child] = make_pair(0, vector<Vertex>());
-    }
-    else{
-     vector<Vertex> parent_child;
-     size_t parent_child_size = query.GetParentSize(child);
-     bool if_extendable = true;
-
-     for(size_t j=0; j<parent_child_size; j++){
-       Vertex parent = query.GetParent(child, j);
-       parent_child.push_back(parent);
-       if(embedding[parent]==-1){
+    size_t parent_child_size = query.GetParentSize(child);
+    bool if_extendable = true;
+    size_t smallest = 0; /*parent with the shortest list, to start the intersection from*/
+
+    for(size_t j=0; j<parent_child_size; j++){
+      Vertex parent = query.GetParent(child, j);
+      if(st.embedding[parent]==-1){
         if_extendable = false;
         break;
-       }
-     }
-
-     if(if_extendable){ /*if extendable, find extendable candidates*/
-        vector<Vertex> candidates;
-
-        size_t child_cs_size = cs.GetCandidateSize(child);
-        Vertex child_cs;
-
-        for(size_t i =0; i<child_cs_size; i++){
-          child_cs = cs.GetCandidate(child, i); /*candidate for mapping*/
-          if(check_candidate(child, child_cs, parent_child)) candidates.push_back(child_cs);
-        }
-        extendable[child] = make_pair(candidates.size(), candidates);
-
-     }
-     else{
-        extendable[child] = make_pair(0, vector<Vertex>());
-     }
+      }
+      if(space.GetEdgeCandidateSize(child, j, st.embedding_index[parent])<
+         space.GetEdgeCandidateSize(child, smallest, st.embedding_index[query.GetParent(child, smallest)])) smallest = j;
+    }
+    if(!if_extendable) continue;
+
+    /*if extendable, intersect the candidates adjacent to each parent's mapping*/
+    uint32_t *candidates = extendable_of(st, child);
+    uint32_t parent_index = st.embedding_index[query.GetParent(child, smallest)];
+    const uint32_t *first = space.GetEdgeCandidates(child, smallest, parent_index);
+    size_t size = space.GetEdgeCandidateSize(child, smallest, parent_index);
+    copy(first, first+size, candidates);
+
+    for(size_t j=0; j<parent_child_size&&size>0; j++){
+      if(j==smallest) continue;
+      parent_index = st.embedding_index[query.GetParent(child, j)];
+      const uint32_t *other = space.GetEdgeCandidates(child, j, parent_index);
+      size_t other_size = space.GetEdgeCandidateSize(child, j, parent_index);
+
+      SEARCH_STAT(size_t before = size);
+      size = IntersectSorted(candidates, size, other, other_size, candidates);
+      SEARCH_STAT(st.stats.intersections++);
+      SEARCH_STAT(st.stats.edge_rejections += before-size);
     }
+    st.extendable_size[child] = size;
+    st.is_extendable[child] = true;
+    st.undo_log.push_back(child);
+    if(postpone_leaves&&is_leaf[child]) continue;
+    st.key[child] = order.GetKey(child, candidates, size);
+    st.heap.Push(child, st.key[child]);
   }
+  SEARCH_STAT(st.stats.update_extendable_ns += chrono::duration_cast<chrono::nanoseconds>(
+                  chrono::steady_clock::now()-start).count());
 }
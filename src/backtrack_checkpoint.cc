@@ -0,0 +1,149 @@
+/**
+ * @file backtrack_checkpoint.cc
+ * @brief checkpoint and resume of a single-threaded search
+ *
+ */
+
+#include "backtrack.h"
+#include <fstream>
+using namespace std;
+
+namespace {
+
+/*
+ * A checkpoint is a text file:
+ *   checkpoint <version>
+ *   <# of query vertices> <root> <# of data vertices> <# of candidates>
+ *   <1 if the embeddings are enumerated, 0 if counted> <1 if symmetries are broken, 0 if not> <# of embeddings>
+ *   <# of root candidates started>
+ *   <# of frames>
+ * and one line per frame of the search stack, from the root
+ *   f <vertex> <mapped candidate index> <# of candidates> <next index> <found> <# of failing vertices> <failing vertices>
+ * The first lines identify the search, so that a checkpoint is not resumed by another one.
+ */
+const int kCheckpointVersion = 2;
+
+}  // namespace
+
+/*write the frontier of the search to filename every interval_seconds (0 for never), when the time limit
+is reached and when RequestCheckpoint is called, so that ResumeFrom can continue it. only a single-threaded
+search writes checkpoints. the file is removed when the search finishes*/
+void Backtrack::SetCheckpoint(const string &filename, double interval_seconds) {
+  checkpoint_file = filename;
+  checkpoint_interval = interval_seconds;
+}
+
+/*write a checkpoint and stop the running search, within kClockCheckInterval search nodes, or the next
+search if none is running. only sets a flag, so that it may be called from a signal handler*/
+void Backtrack::RequestCheckpoint() {
+  checkpoint_requested = true;
+}
+
+/*make the next search continue from the checkpoint in filename instead of starting from the root.
+it then finds the embeddings the search of the checkpoint had not found yet, and counts them on top of
+those it had. the query, candidate set, matching order and mode must be those of the checkpoint.
+returns false if the file cannot be read or is not a checkpoint of this query. the search then throws
+std::runtime_error if the checkpoint was taken in another mode or with other symmetry breaking, or if
+its frames do not fit the candidate set or the matching order*/
+bool Backtrack::ResumeFrom(const string &filename) {
+  ifstream fin(filename);
+  string magic;
+  int version = 0;
+  if(!(fin>>magic>>version)||magic!="checkpoint"||version!=kCheckpointVersion){
+    cerr << "Checkpoint " << filename << " not found or of another version\n";
+    return false;
+  }
+  if(num_threads>1){
+    cerr << "Only a single-threaded search can resume from a checkpoint\n";
+    return false;
+  }
+
+  size_t num_query_vertices, num_data_vertices, num_candidates, num_frames;
+  Vertex saved_root;
+  fin >> num_query_vertices >> saved_root >> num_data_vertices >> num_candidates;
+  if(!fin||num_query_vertices!=q_size||saved_root!=root||num_data_vertices!=data.GetNumVertices()||
+     num_candidates!=cs.GetNumCandidates()){
+    cerr << "Checkpoint " << filename << " is not one of this query and data graph\n";
+    return false;
+  }
+
+  Checkpoint saved;
+  fin >> saved.enumerate >> saved.symmetry >> saved.count >> saved.roots_started >> num_frames;
+  for(size_t d=0; fin&&d<num_frames&&d<q_size; d++){
+    SavedFrame frame;
+    size_t num_failing;
+    char tag;
+    fin >> tag >> frame.curr >> frame.mapped_index >> frame.size >> frame.next_index >> frame.found >> num_failing;
+    for(size_t k=0; fin&&k<num_failing&&k<q_size; k++){
+      Vertex u;
+      fin >> u;
+      frame.failing_set.push_back(u);
+    }
+    if(tag!='f') fin.setstate(ios::failbit);
+    saved.frames.push_back(frame);
+  }
+  if(!fin||num_frames==0||saved.frames.size()!=num_frames){
+    cerr << "Checkpoint " << filename << " is truncated\n";
+    return false;
+  }
+  resume = saved;
+  return true;
+}
+
+/*write the stack of st, at the top of its frame loop, to the checkpoint file. the embeddings printed
+so far are flushed first, so that the output matches the count of the checkpoint. the file is written
+next to the old one and renamed over it, so that a crash leaves either of them whole*/
+bool Backtrack::save_checkpoint(const SearchState &st){
+  out->Flush();
+
+  string temporary = checkpoint_file+".tmp";
+  ofstream fout(temporary);
+  fout << "checkpoint " << kCheckpointVersion << "\n";
+  fout << q_size << " " << root << " " << data.GetNumVertices() << " " << cs.GetNumCandidates() << "\n";
+  fout << (callback!=nullptr) << " " << symmetry << " " << cnt.load() << "\n" << roots_started.load() << "\n";
+  fout << st.frames.size() << "\n";
+  for(size_t d=0; d<st.frames.size(); d++){
+    const SearchState::Frame &frame = st.frames[d];
+    uint32_t mapped_index = d+1<st.frames.size() ? frame.candidates[frame.next_index-1] : 0;
+    vector<Vertex> failing;
+    for(size_t u=0; u<q_size; u++) if(st.failing_sets[d].Contains(u)) failing.push_back(u);
+
+    fout << "f " << frame.curr << " " << mapped_index << " " << frame.size << " " << frame.next_index << " "
+         << frame.found << " " << failing.size();
+    for(Vertex u: failing) fout << " " << u;
+    fout << "\n";
+  }
+  fout.close();
+  if(!fout) return false;
+  return rename(temporary.c_str(), checkpoint_file.c_str())==0;
+}
+
+/*rebuild the stack of the checkpoint on the clean state st by mapping the vertex of every frame but the last
+one again, which recomputes the extendable candidates and the matching order. returns false if they are not
+those of the checkpoint*/
+bool Backtrack::restore_checkpoint(SearchState &st, const uint32_t *root_candidates, size_t root_size){
+  for(size_t d=0; d<resume.frames.size(); d++){
+    const SavedFrame &saved = resume.frames[d];
+    if(saved.curr!=(d==0 ? root : next_vertex(st))) return false;
+
+    const uint32_t *candidates = d==0 ? root_candidates : extendable_of(st, saved.curr);
+    size_t size = d==0 ? root_size : st.extendable_size[saved.curr];
+    if(saved.size!=size||saved.next_index>size) return false;
+
+    push_frame(st, saved.curr, candidates, size);
+    st.frames[d].next_index = saved.next_index;
+    st.frames[d].found = saved.found;
+    st.failing_sets[d].Clear();
+    for(Vertex u: saved.failing_set){
+      if(u<0||(size_t)u>=q_size) return false;
+      st.failing_sets[d].Insert(u);
+    }
+
+    if(d+1<resume.frames.size()){
+      if(saved.next_index==0||candidates[saved.next_index-1]!=saved.mapped_index) return false;
+      st.frames[d].descended = true;
+      map_vertex(st, saved.curr, saved.mapped_index);
+    }
+  }
+  return true;
+}
@@ -5,39 +5,214 @@
 
 #include "candidate_set.h"
 
-CandidateSet::CandidateSet(const std::string& filename) {
+#include "dag.h"
+#include "graph.h"
+
+/**
+ * @brief Reads a candidate set file. Throws std::runtime_error if the file is
+ * missing or malformed.
+ *
+ * @param filename
+ * @param data data graph whose file ids the candidates are, translated into
+ * its internal ids if it is reordered.
+ */
+CandidateSet::CandidateSet(const std::string& filename, const Graph *data) {
   std::ifstream fin(filename);
 
-  if (!fin.is_open()) {
-    std::cout << "Candidate set file " << filename << " not found!\n";
-    exit(EXIT_FAILURE);
-  }
+  if (!fin.is_open())
+    throw std::runtime_error("Candidate set file " + filename + " not found");
+  const std::runtime_error malformed("Candidate set file " + filename +
+                                     " is malformed");
 
   char type;
   size_t num_query_vertices;
 
-  fin >> type >> num_query_vertices;
+  if (!(fin >> type >> num_query_vertices) || type != 't') throw malformed;
 
-  cs_.resize(num_query_vertices);
+  // the file may list the query vertices in any order
+  std::vector<std::vector<Vertex>> cs(num_query_vertices);
 
   while (fin >> type) {
     if (type == 'c') {
       Vertex id;
       size_t candidate_set_size;
 
-      fin >> id >> candidate_set_size;
-
-      cs_[id].resize(candidate_set_size);
+      if (!(fin >> id >> candidate_set_size) || id < 0 ||
+          static_cast<size_t>(id) >= num_query_vertices)
+        throw malformed;
 
+      cs[id].clear();
       for (size_t i = 0; i < candidate_set_size; ++i) {
         Vertex data_vertex;
-        fin >> data_vertex;
-        cs_[id][i] = data_vertex;
+        // an id that is not a vertex of the data graph cannot be translated
+        if (!(fin >> data_vertex) || data_vertex < 0 ||
+            (data != nullptr &&
+             static_cast<size_t>(data_vertex) >= data->GetNumVertices()))
+          throw malformed;
+        cs[id].push_back(data != nullptr ? data->GetInternalId(data_vertex)
+                                         : data_vertex);
       }
+
+      // keep candidates sorted by id, so that they can be intersected with
+      // neighbor ranges (see Graph::IntersectNeighbors)
+      std::sort(cs[id].begin(), cs[id].end());
+      cs[id].erase(std::unique(cs[id].begin(), cs[id].end()), cs[id].end());
     }
   }
 
   fin.close();
+
+  offset_.resize(num_query_vertices + 1);
+  offset_[0] = 0;
+  for (size_t u = 0; u < num_query_vertices; ++u)
+    offset_[u + 1] = offset_[u] + cs[u].size();
+  candidates_.reserve(offset_[num_query_vertices]);
+  for (size_t u = 0; u < num_query_vertices; ++u)
+    candidates_.insert(candidates_.end(), cs[u].begin(), cs[u].end());
+}
+
+/**
+ * @brief Builds the candidate sets in process: a data vertex v is a candidate
+ * of query vertex u if it has the label of u, at least the degree of u, and,
+ * for every label l, at least as many neighbors with label l as u (neighbor
+ * label frequency filter). Candidates are sorted in ascending order of id.
+ *
+ * @param data data graph.
+ * @param query query graph, loaded after data with is_query = true.
+ */
+CandidateSet::CandidateSet(const Graph &data, const Graph &query) {
+  size_t num_data_labels = data.GetNumLabels();
+
+  offset_.resize(query.GetNumVertices() + 1);
+  offset_[0] = 0;
+
+  // data vertices grouped by label, in ascending order of id
+  std::vector<std::vector<Vertex>> vertices_by_label(num_data_labels);
+  for (size_t v = 0; v < data.GetNumVertices(); ++v)
+    vertices_by_label[data.GetLabel(v)].push_back(v);
+
+  // (label, # of neighbors with the label) of a query vertex
+  std::vector<std::pair<Label, size_t>> frequency;
+
+  for (size_t u = 0; u < query.GetNumVertices(); ++u) {
+    offset_[u + 1] = offset_[u];
+
+    Label l = query.GetLabel(u);
+    if (static_cast<size_t>(l) >= num_data_labels) continue;
+
+    // neighbors are sorted by label, so each label is one run
+    frequency.clear();
+    bool matchable = true;
+    for (size_t offset = query.GetNeighborStartOffset(u);
+         offset < query.GetNeighborEndOffset(u); ++offset) {
+      Label neighbor_label = query.GetLabel(query.GetNeighbor(offset));
+      if (!frequency.empty() && frequency.back().first == neighbor_label)
+        continue;
+      if (static_cast<size_t>(neighbor_label) >= num_data_labels)
+        matchable = false;
+      frequency.push_back(std::make_pair(
+          neighbor_label, query.GetNeighborLabelFrequency(u, neighbor_label)));
+    }
+    if (!matchable) continue;
+
+    for (Vertex v : vertices_by_label[l]) {
+      if (data.GetDegree(v) < query.GetDegree(u)) continue;
+
+      bool is_candidate = true;
+      for (const std::pair<Label, size_t> &f : frequency) {
+        if (data.GetNeighborLabelFrequency(v, f.first) < f.second) {
+          is_candidate = false;
+          break;
+        }
+      }
+      if (is_candidate) candidates_.push_back(v);
+    }
+    offset_[u + 1] = candidates_.size();
+  }
 }
 
 CandidateSet::~CandidateSet() {}
+
+/**
+ * @brief Refines the candidate sets by dynamic programming over the query DAG
+ * as in DAF: a candidate v of u is kept only if v has a neighbor among the
+ * candidates of every child of u (in reverse topological order), or of every
+ * parent of u (in topological order). Passes alternate between the two
+ * directions, starting from the children, until neither direction removes a
+ * candidate or max_passes passes are done.
+ *
+ * @param data data graph.
+ * @param query query DAG built from these candidate sets.
+ * @param max_passes
+ */
+void CandidateSet::Refine(const Graph &data, const Dag &query, int max_passes) {
+  const std::vector<Vertex> &order = query.GetTopologicalOrder();
+  size_t num_data_labels = data.GetNumLabels();
+
+  // is_candidate[w] is 1 while w is a candidate of the neighbor being checked
+  std::vector<char> is_candidate(data.GetNumVertices(), 0);
+
+  // candidates of u are kept in place at the front of its range, and the
+  // array is compacted once at the end
+  std::vector<size_t> size(offset_.size() - 1);
+  for (size_t u = 0; u < size.size(); ++u) size[u] = GetCandidateSize(u);
+
+  // # of passes in a row that removed no candidate
+  int unchanged = 0;
+  for (int pass = 0; pass < max_passes && unchanged < 2; ++pass) {
+    bool from_children = pass % 2 == 0;
+    bool removed = false;
+
+    for (size_t k = 0; k < order.size(); ++k) {
+      Vertex u = from_children ? order[order.size() - 1 - k] : order[k];
+      size_t num_neighbors =
+          from_children ? query.GetChildSize(u) : query.GetParentSize(u);
+      Vertex *candidates = candidates_.data() + offset_[u];
+
+      for (size_t j = 0; j < num_neighbors && size[u] > 0; ++j) {
+        Vertex neighbor =
+            from_children ? query.GetChild(u, j) : query.GetParent(u, j);
+        Label l = query.GetLabel(neighbor);
+        if (static_cast<size_t>(l) >= num_data_labels) {
+          size[u] = 0;
+          removed = true;
+          break;
+        }
+
+        const Vertex *neighbor_candidates = GetCandidates(neighbor);
+        for (size_t i = 0; i < size[neighbor]; ++i)
+          is_candidate[neighbor_candidates[i]] = 1;
+
+        size_t kept = 0;
+        for (size_t i = 0; i < size[u]; ++i) {
+          Vertex v = candidates[i];
+          std::pair<size_t, size_t> range = data.GetNeighborRange(v, l);
+          for (size_t offset = range.first; offset < range.second; ++offset) {
+            if (is_candidate[data.GetNeighbor(offset)]) {
+              candidates[kept++] = v;
+              break;
+            }
+          }
+        }
+        if (kept < size[u]) removed = true;
+        size[u] = kept;
+
+        for (size_t i = 0; i < size[neighbor]; ++i)
+          is_candidate[neighbor_candidates[i]] = 0;
+      }
+    }
+    unchanged = removed ? 0 : unchanged + 1;
+  }
+
+  size_t end = 0;
+  for (size_t u = 0; u < size.size(); ++u) {
+    std::copy(candidates_.begin() + offset_[u],
+              candidates_.begin() + offset_[u] + size[u],
+              candidates_.begin() + end);
+    offset_[u] = end;
+    end += size[u];
+  }
+  offset_[size.size()] = end;
+  candidates_.resize(end);
+  candidates_.shrink_to_fit();
+}
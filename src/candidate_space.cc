@@ -0,0 +1,67 @@
+/**
+ * @file candidate_space.cc
+ *
+ */
+
+#include "candidate_space.h"
+
+CandidateSpace::CandidateSpace(const Graph &data, const Dag &query,
+                               const CandidateSet &cs) {
+  size_t num_query_vertices = query.GetNumVertices();
+
+  first_edge_.resize(num_query_vertices + 1);
+  first_edge_[0] = 0;
+  for (Vertex u = 0; u < static_cast<Vertex>(num_query_vertices); ++u)
+    first_edge_[u + 1] = first_edge_[u] + query.GetParentSize(u);
+
+  /*every list of an edge, with one extra list id for its end*/
+  first_list_.resize(first_edge_[num_query_vertices]);
+  size_t num_lists = 0;
+  for (Vertex u = 0; u < static_cast<Vertex>(num_query_vertices); ++u) {
+    for (size_t j = 0; j < query.GetParentSize(u); ++j) {
+      first_list_[first_edge_[u] + j] = num_lists;
+      num_lists += cs.GetCandidateSize(query.GetParent(u, j)) + 1;
+    }
+  }
+  offset_.resize(num_lists);
+
+  /*position[v] = index of data vertex v in the candidate set of u, or -1*/
+  std::vector<int32_t> position(data.GetNumVertices(), -1);
+  std::vector<Vertex> adjacent;
+
+  for (Vertex u = 0; u < static_cast<Vertex>(num_query_vertices); ++u) {
+    size_t num_parents = query.GetParentSize(u);
+    if (num_parents == 0) continue;
+
+    const Vertex *candidates = cs.GetCandidates(u);
+    size_t num_candidates = cs.GetCandidateSize(u);
+    for (size_t i = 0; i < num_candidates; ++i) position[candidates[i]] = i;
+    adjacent.resize(num_candidates);
+
+    for (size_t j = 0; j < num_parents; ++j) {
+      Vertex p = query.GetParent(u, j);
+      const Vertex *parent_candidates = cs.GetCandidates(p);
+      size_t num_parent_candidates = cs.GetCandidateSize(p);
+      size_t *offset = offset_.data() + ListId(u, j, 0);
+
+      offset[0] = index_.size();
+
+      for (size_t i = 0; i < num_parent_candidates; ++i) {
+        /*candidates are sorted by id, and so are their indices.
+        a candidate with another label than u cannot be in any embedding*/
+        size_t size = data.IntersectNeighbors(
+            parent_candidates[i], query.GetLabel(u), candidates,
+            num_candidates, adjacent.data());
+
+        for (size_t k = 0; k < size; ++k)
+          index_.push_back(position[adjacent[k]]);
+        offset[i + 1] = index_.size();
+      }
+    }
+
+    for (size_t i = 0; i < num_candidates; ++i) position[candidates[i]] = -1;
+  }
+  index_.shrink_to_fit();
+}
+
+CandidateSpace::~CandidateSpace() {}
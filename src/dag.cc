@@ -6,6 +6,62 @@
 
 Dag::Dag(const std::string& filename, const CandidateSet &candidateSet, bool is_query) : Graph(filename, candidateSet, is_query)
 {
+    size_t n = GetNumVertices();
+
+    //flatten the parents and children, and mark both directions of every edge
+    words_ = (n + 63) / 64;
+    adjacency_.assign(n * words_, 0);
+    parent_offset_.assign(n + 1, 0);
+    child_offset_.assign(n + 1, 0);
+    for (Vertex v = 0; v < (Vertex) n; v++) {
+        parent_.insert(parent_.end(), parents[v].begin(), parents[v].end());
+        child_.insert(child_.end(), dag_adj[v].begin(), dag_adj[v].end());
+        parent_offset_[v + 1] = parent_.size();
+        child_offset_[v + 1] = child_.size();
+        for (Vertex w : dag_adj[v]) {
+            adjacency_[v * words_ + (w >> 6)] |= uint64_t(1) << (w & 63);
+            adjacency_[w * words_ + (v >> 6)] |= uint64_t(1) << (v & 63);
+        }
+    }
+
+    //collect ancestors in topological order, so that every parent is done before its children
+    ancestors_.assign(n, VertexSet(n));
+    std::vector<size_t> remaining_parents(n);
+    for (Vertex v = 0; v < (Vertex) n; v++) {
+        remaining_parents[v] = GetParentSize(v);
+        if (remaining_parents[v] == 0) topological_order_.push_back(v);
+    }
+    for (size_t i = 0; i < topological_order_.size(); i++) {
+        Vertex v = topological_order_[i];
+        ancestors_[v].Insert(v);
+        for (size_t j = 0; j < GetChildSize(v); j++) {
+            Vertex child = GetChild(v, j);
+            ancestors_[child].Union(ancestors_[v]);
+            if (--remaining_parents[child] == 0) topological_order_.push_back(child);
+        }
+    }
+
+    //neighborhood equivalence: compare the rows of the adjacency matrix without the bits of the two
+    //vertices. the relation is transitive, so every vertex is only compared with the first vertex of
+    //each class
+    equivalence_class_.resize(n);
+    for (Vertex v = 0; v < (Vertex) n; v++) {
+        equivalence_class_[v] = v;
+        for (Vertex u = 0; u < v; u++) {
+            if (equivalence_class_[u] != u || GetLabel(u) != GetLabel(v)) continue;
+            bool equivalent = true;
+            for (size_t i = 0; i < words_ && equivalent; i++) {
+                uint64_t mask = ~uint64_t(0);
+                if ((size_t) (u >> 6) == i) mask &= ~(uint64_t(1) << (u & 63));
+                if ((size_t) (v >> 6) == i) mask &= ~(uint64_t(1) << (v & 63));
+                equivalent = (adjacency_[u * words_ + i] & mask) == (adjacency_[v * words_ + i] & mask);
+            }
+            if (equivalent) {
+                equivalence_class_[v] = u;
+                break;
+            }
+        }
+    }
 };
 Dag::~Dag() {}
 
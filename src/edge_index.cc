@@ -0,0 +1,73 @@
+/**
+ * @file edge_index.cc
+ *
+ */
+
+#include "edge_index.h"
+
+#include "graph.h"
+
+namespace {
+/*smallest degree of a hub, so that small graphs are only hashed*/
+const size_t kMinHubDegree = 64;
+}  // namespace
+
+const uint64_t EdgeIndex::kEmptyKey;
+
+EdgeIndex::EdgeIndex(const Graph &graph) : EdgeIndex() {
+  size_t n = graph.GetNumVertices();
+  words_ = (n + 63) / 64;
+
+  // a bitmap of n bits is not larger than a neighbor list of n / 32 vertices
+  hub_.assign(n, -1);
+  int32_t num_hubs = 0;
+  size_t hashed = 0;
+  for (size_t v = 0; v < n; ++v) {
+    size_t degree = graph.GetDegree(v);
+    if (degree >= kMinHubDegree && degree * 32 >= n) hub_[v] = num_hubs++;
+  }
+
+  bitmaps_.assign(num_hubs * words_, 0);
+  for (size_t v = 0; v < n; ++v) {
+    for (size_t j = graph.GetNeighborStartOffset(v);
+         j < graph.GetNeighborEndOffset(v); ++j) {
+      Vertex w = graph.GetNeighbor(j);
+      if (hub_[v] != -1)
+        bitmaps_[hub_[v] * words_ + w / 64] |= 1ULL << (w % 64);
+      else if (hub_[w] == -1 && static_cast<Vertex>(v) < w)
+        hashed++;
+    }
+  }
+
+  size_t size = 2;
+  shift_ = 63;
+  while (size < 2 * hashed) {
+    size *= 2;
+    shift_--;
+  }
+  table_.assign(size, kEmptyKey);
+  mask_ = size - 1;
+
+  for (size_t v = 0; v < n; ++v) {
+    if (hub_[v] != -1) continue;
+    for (size_t j = graph.GetNeighborStartOffset(v);
+         j < graph.GetNeighborEndOffset(v); ++j) {
+      Vertex w = graph.GetNeighbor(j);
+      if (hub_[w] != -1 || w <= static_cast<Vertex>(v)) continue;
+      uint64_t key = Key(v, w);
+      size_t i = Slot(key);
+      while (table_[i] != kEmptyKey) i = (i + 1) & mask_;
+      table_[i] = key;
+    }
+  }
+}
+
+/**
+ * @brief Returns the # of bytes of the index.
+ *
+ * @return size_t
+ */
+size_t EdgeIndex::GetMemorySize() const {
+  return hub_.size() * sizeof(int32_t) + bitmaps_.size() * sizeof(uint64_t) +
+         table_.size() * sizeof(uint64_t);
+}
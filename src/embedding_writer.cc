@@ -0,0 +1,253 @@
+/**
+ * @file embedding_writer.cc
+ *
+ */
+
+#include "embedding_writer.h"
+
+#include <unistd.h>
+
+#include <cstring>
+
+namespace {
+
+const char kEmbeddingMagic[8] = {'I', 'E', 'M', 'B', 'E', 'D', 'S', '1'};
+const uint32_t kEmbeddingVersion = 1;
+const uint32_t kByteOrderMark = 0x01020304;
+
+/*magic, version, byte-order mark, # of query vertices*/
+const size_t kHeaderSize = sizeof(kEmbeddingMagic) + 3 * sizeof(uint32_t);
+/*# of embeddings, # of payload bytes*/
+const size_t kBlockHeaderSize = 2 * sizeof(uint32_t);
+
+/*longest text of one vertex: " " and 10 digits with a sign*/
+const size_t kMaxTextVertexSize = 12;
+/*longest zigzag varint of a 64-bit difference*/
+const size_t kMaxVarintSize = 10;
+
+/*writes the decimal digits of x at p and returns the end*/
+char *FormatInt(char *p, int64_t x) {
+  uint64_t u = x;
+  if (x < 0) {
+    *p++ = '-';
+    u = -static_cast<uint64_t>(x);
+  }
+  char digits[20];
+  int n = 0;
+  do {
+    digits[n++] = '0' + u % 10;
+    u /= 10;
+  } while (u != 0);
+  while (n > 0) *p++ = digits[--n];
+  return p;
+}
+
+char *EncodeVarint(char *p, int64_t x) {
+  uint64_t z = (static_cast<uint64_t>(x) << 1) ^ static_cast<uint64_t>(x >> 63);
+  while (z >= 0x80) {
+    *p++ = static_cast<char>(z | 0x80);
+    z >>= 7;
+  }
+  *p++ = static_cast<char>(z);
+  return p;
+}
+
+bool DecodeVarint(const char *&p, const char *end, int64_t &x) {
+  uint64_t z = 0;
+  for (int shift = 0; p < end && shift < 64; shift += 7) {
+    uint8_t byte = *p++;
+    z |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (byte < 0x80) {
+      x = static_cast<int64_t>(z >> 1) ^ -static_cast<int64_t>(z & 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+/**
+ * @brief Parses the name of an output format given on the command line: text
+ * or binary.
+ *
+ * @param name
+ * @param format output.
+ * @return bool false if the name is unknown.
+ */
+bool ParseOutputFormat(const std::string &name, OutputFormat &format) {
+  if (name == "text")
+    format = kTextOutput;
+  else if (name == "binary")
+    format = kBinaryOutput;
+  else
+    return false;
+  return true;
+}
+
+EmbeddingWriter::EmbeddingWriter(int fd, OutputFormat format,
+                                 size_t buffer_size)
+    : fd_(fd), format_(format), ok_(true), buffer_(buffer_size), size_(0),
+      block_embeddings_(0) {}
+
+EmbeddingWriter::~EmbeddingWriter() { Flush(); }
+
+/**
+ * @brief Writes the header of the output.
+ *
+ * @param num_query_vertices
+ */
+void EmbeddingWriter::WriteHeader(size_t num_query_vertices) {
+  if (format_ == kTextOutput) {
+    Reserve(2 + kMaxTextVertexSize + 1);
+    char *p = buffer_.data() + size_;
+    *p++ = 't';
+    *p++ = ' ';
+    p = FormatInt(p, num_query_vertices);
+    *p++ = '\n';
+    size_ = p - buffer_.data();
+    return;
+  }
+
+  // the binary embeddings are differences from the previous ones
+  previous_.assign(num_query_vertices, 0);
+  Flush();
+  char header[kHeaderSize];
+  uint32_t fields[3] = {kEmbeddingVersion, kByteOrderMark,
+                        static_cast<uint32_t>(num_query_vertices)};
+  std::memcpy(header, kEmbeddingMagic, sizeof(kEmbeddingMagic));
+  std::memcpy(header + sizeof(kEmbeddingMagic), fields, sizeof(fields));
+  ok_ = WriteAll(header, sizeof(header)) && ok_;
+}
+
+/**
+ * @brief Appends one embedding, where embedding[u] is the data vertex of query
+ * vertex u.
+ *
+ * @param embedding
+ * @param size # of query vertices, as given to WriteHeader.
+ */
+void EmbeddingWriter::Write(const Vertex *embedding, size_t size) {
+  if (format_ == kTextOutput) {
+    Reserve(2 + size * kMaxTextVertexSize + 1);
+    char *p = buffer_.data() + size_;
+    *p++ = 'a';
+    *p++ = ' ';
+    for (size_t u = 0; u < size; ++u) {
+      p = FormatInt(p, embedding[u]);
+      *p++ = ' ';
+    }
+    *p++ = '\n';
+    size_ = p - buffer_.data();
+    return;
+  }
+
+  Reserve(size * kMaxVarintSize);
+  if (size_ == 0) size_ = kBlockHeaderSize;  // start of a block
+  char *p = buffer_.data() + size_;
+  for (size_t u = 0; u < size; ++u) {
+    p = EncodeVarint(p, static_cast<int64_t>(embedding[u]) - previous_[u]);
+    previous_[u] = embedding[u];
+  }
+  size_ = p - buffer_.data();
+  block_embeddings_++;
+}
+
+/**
+ * @brief Writes the buffered output, ending the current binary block.
+ *
+ * @return bool false if some write has failed.
+ */
+bool EmbeddingWriter::Flush() {
+  if (size_ == 0) return ok_;
+
+  if (format_ == kBinaryOutput) {
+    uint32_t fields[2] = {block_embeddings_,
+                          static_cast<uint32_t>(size_ - kBlockHeaderSize)};
+    std::memcpy(buffer_.data(), fields, sizeof(fields));
+    block_embeddings_ = 0;
+    std::fill(previous_.begin(), previous_.end(), 0);
+  }
+
+  ok_ = WriteAll(buffer_.data(), size_) && ok_;
+  size_ = 0;
+  return ok_;
+}
+
+/*makes room for size more bytes, flushing the buffer if it is too full*/
+void EmbeddingWriter::Reserve(size_t size) {
+  size_t needed = size + kBlockHeaderSize;
+  if (size_ + needed > buffer_.size()) Flush();
+  if (needed > buffer_.size()) buffer_.resize(needed);
+}
+
+bool EmbeddingWriter::WriteAll(const char *data, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(fd_, data, size);
+    if (written <= 0) return false;
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+/**
+ * @brief Reads a binary embedding file and writes its embeddings to out.
+ *
+ * @param filename
+ * @param out
+ * @return bool false if the file cannot be read or is malformed, e.g. a block
+ * is longer than the rest of the file, or than its embeddings can take.
+ */
+bool DecodeEmbeddings(const std::string &filename, EmbeddingWriter &out) {
+  std::ifstream fin(filename, std::ios::binary | std::ios::ate);
+  if (!fin.is_open()) return false;
+  uint64_t file_size = fin.tellg();
+  fin.seekg(0);
+  char header[kHeaderSize];
+  if (!fin.read(header, sizeof(header))) return false;
+
+  uint32_t fields[3];
+  std::memcpy(fields, header + sizeof(kEmbeddingMagic), sizeof(fields));
+  if (std::memcmp(header, kEmbeddingMagic, sizeof(kEmbeddingMagic)) != 0 ||
+      fields[0] != kEmbeddingVersion || fields[1] != kByteOrderMark)
+    return false;
+
+  // a query has at least one vertex
+  size_t num_query_vertices = fields[2];
+  if (num_query_vertices == 0) return false;
+  out.WriteHeader(num_query_vertices);
+
+  std::vector<Vertex> embedding;
+  std::vector<char> payload;
+  char block_header[kBlockHeaderSize];
+  while (fin.read(block_header, sizeof(block_header))) {
+    uint32_t block[2];
+    std::memcpy(block, block_header, sizeof(block));
+    // every vertex of an embedding takes 1 to kMaxVarintSize bytes, and the
+    // payload must be in the file, so that a bad size is not allocated
+    uint64_t num_values = static_cast<uint64_t>(block[0]) * num_query_vertices;
+    uint64_t left = file_size - static_cast<uint64_t>(fin.tellg());
+    if (block[1] > left || num_values > block[1] ||
+        num_values < (block[1] + kMaxVarintSize - 1) / kMaxVarintSize)
+      return false;
+    if (block[0] > 0 && embedding.empty())
+      embedding.resize(num_query_vertices);
+    payload.resize(block[1]);
+    if (!fin.read(payload.data(), payload.size())) return false;
+
+    const char *p = payload.data();
+    const char *end = p + payload.size();
+    std::fill(embedding.begin(), embedding.end(), 0);
+    for (uint32_t k = 0; k < block[0]; ++k) {
+      for (size_t u = 0; u < num_query_vertices; ++u) {
+        int64_t delta;
+        if (!DecodeVarint(p, end, delta)) return false;
+        embedding[u] += delta;
+      }
+      out.Write(embedding.data(), num_query_vertices);
+    }
+    if (p != end) return false;
+  }
+  return fin.eof() && fin.gcount() == 0 && out.Flush();
+}
@@ -7,172 +7,126 @@
 #include <queue>
 #include <algorithm>
 #include "graph.h"
+#include "graph_reader.h"
+#include "intersection.h"
 
-namespace {
-std::vector<Label> transferred_label;
-void TransferLabel(const std::string &filename) {
-    //initialize transferred_label array by order(tranferred_label[smallest label] <- 0)
-  std::ifstream fin(filename);
-
-  if (!fin.is_open()) {
-    std::cout << "Graph file " << filename << " not found!\n";
-    exit(EXIT_FAILURE);
-  }
-
-  char type;
-  int32_t graph_id_;
-  size_t num_vertices_;
+std::vector<Label> Graph::transferred_label_;
+Label Graph::unknown_label_ = 0;
 
-  std::set<Label> label_set;
+void Graph::TransferLabel(const std::vector<Label> &labels) {
+    //initialize transferred_label_ array by order(tranferred_label_[smallest label] <- 0)
+  std::vector<Label> label_set(labels);
+  std::sort(label_set.begin(), label_set.end());
+  label_set.erase(std::unique(label_set.begin(), label_set.end()),
+                  label_set.end());
 
-  fin >> type >> graph_id_ >> num_vertices_;
-
-  // preprocessing
-  while (fin >> type) {
-    if (type == 'v') {
-      Vertex id;
-      Label l;
-      fin >> id >> l;
-
-      label_set.insert(l);
-    } else if (type == 'e') {
-      Vertex v1, v2;
-      Label l;
-      fin >> v1 >> v2 >> l;
-    }
-  }
-
-  fin.close();
-
-  transferred_label.resize(
-      *std::max_element(label_set.begin(), label_set.end()) + 1, -1);
+  transferred_label_.assign(label_set.empty() ? 0 : label_set.back() + 1, -1);
 
   Label new_label = 0;
   for (Label l : label_set) {
-    transferred_label[l] = new_label;
+    if (l < 0) continue;
+    transferred_label_[l] = new_label;
     new_label += 1;
   }
+  unknown_label_ = new_label;
 }
-}  // namespace
-
-Graph::Graph(const std::string &filename, bool is_query) {
 
-    if (!is_query) {
-        //if !is_query, transferred_label array was not initialized.
-    TransferLabel(filename);
-    }
-    std::vector<std::vector<Vertex>> adj_list;
+// labels that are not in the data graph become unknown_label_, a label that
+// no data vertex has, so that they can still index the arrays of a query
+Label Graph::Transferred(Label l) {
+  if (l < 0 || static_cast<size_t>(l) >= transferred_label_.size() ||
+      transferred_label_[l] == -1)
+    return unknown_label_;
+  return transferred_label_[l];
+}
 
-  // Load Graph
-  std::ifstream fin(filename);
-  std::set<Label> label_set;
+namespace {
+/*the loaders throw std::runtime_error on a bad file, so that the server can
+answer the request with an error instead of exiting*/
+void ReadGraph(const std::string &filename, GraphFile &file) {
+  if (!ReadGraphFile(filename, file) || file.num_vertices == 0)
+    throw std::runtime_error("Graph file " + filename +
+                             " not found or malformed");
+}
+}  // namespace
 
-  if (!fin.is_open()) {
-    std::cout << "Graph file " << filename << " not found!\n";
-    exit(EXIT_FAILURE);
+Graph::Graph(const std::string &filename, bool is_query,
+             bool dense_label_index, VertexOrder order) {
+  if (!is_query && IsSnapshot(filename)) {
+    if (!LoadSnapshot(filename, dense_label_index))
+      throw std::runtime_error("Graph snapshot " + filename +
+                               " is corrupted or of another version");
+    return;
   }
 
-  char type;
+  // Load Graph: one pass over the file, then the CSR arrays are filled from
+  // the edge list directly
+  GraphFile file;
+  ReadGraph(filename, file);
 
-  fin >> type >> graph_id_ >> num_vertices_;
+    if (!is_query) {
+        //if !is_query, transferred_label array was not initialized.
+    TransferLabel(file.labels);
+    Reorder(file, order);
+    }
 
-  adj_list.resize(num_vertices_);
+  graph_id_ = file.graph_id;
+  num_vertices_ = file.num_vertices;
+  num_edges_ = file.edges.size();
 
-  start_offset_.resize(num_vertices_ + 1);
   label_.resize(num_vertices_);
+  start_offset_.assign(num_vertices_ + 1, 0);
 
-  num_edges_ = 0;
+  for (size_t v = 0; v < num_vertices_; ++v)
+    label_[v] = Transferred(file.labels[v]);
 
-  // preprocessing
-  while (fin >> type) {
-    if (type == 'v') {
-      Vertex id;
-      Label l;
-      fin >> id >> l;
-
-      if (static_cast<size_t>(l) >= transferred_label.size())
-        l = -1;
-      else
-        l = transferred_label[l];
-
-      label_[id] = l;
-      label_set.insert(l);
-    } else if (type == 'e') {
-        //labeling by vertex, not by edge. I think this code discard edge label
-      Vertex v1, v2;
-      Label l;
-      fin >> v1 >> v2 >> l;
-
-      adj_list[v1].push_back(v2);
-      adj_list[v2].push_back(v1);
-
-      num_edges_ += 1;
-    }
-  }
-
-
-  fin.close();
-
-  adj_array_.resize(num_edges_ * 2);
+  std::vector<Label> label_set(label_.begin(), label_.end());
+  std::sort(label_set.begin(), label_set.end());
+  label_set.erase(std::unique(label_set.begin(), label_set.end()),
+                  label_set.end());
 
   num_labels_ = label_set.size();
 
-  max_label_ = *std::max_element(label_set.begin(), label_set.end());
+  max_label_ = label_set.back();
 
   label_frequency_.resize(max_label_ + 1);
 
-  start_offset_by_label_.resize(num_vertices_ * (max_label_ + 1));
-
-  start_offset_[0] = 0;
+  // count degrees, then start_offset_[v] is the start index where v's
+  // adj_vertex is saved: adj_array_[start_offset[v]]~adj_array[start_offset[v+1]]
+  for (const std::pair<Vertex, Vertex> &e : file.edges) {
+    start_offset_[e.first + 1] += 1;
+    start_offset_[e.second + 1] += 1;
+  }
+  for (size_t i = 0; i < num_vertices_; ++i)
+    start_offset_[i + 1] += start_offset_[i];
 
-  for (size_t i = 0; i < adj_list.size(); ++i) {
-      //initialize start_offset_ by start index where i's adj_vertex is saved
-      //vertex 0's adj_vertex id is saved at adj_array_[start_offset[id]]~adj_array[start_offset[id+1]]
-    start_offset_[i + 1] = start_offset_[i] + adj_list[i].size();
+  adj_array_.resize(num_edges_ * 2);
+  {
+    std::vector<size_t> cursor(start_offset_.begin(), start_offset_.end() - 1);
+    for (const std::pair<Vertex, Vertex> &e : file.edges) {
+      adj_array_[cursor[e.first]++] = e.second;
+      adj_array_[cursor[e.second]++] = e.first;
+    }
   }
 
-  for (size_t i = 0; i < adj_list.size(); ++i) {
+  for (size_t i = 0; i < num_vertices_; ++i) {
     label_frequency_[GetLabel(i)] += 1;
 
-    auto &neighbors = adj_list[i];
-
-    if (neighbors.size() == 0) continue;
+    auto neighbors_begin = adj_array_.begin() + start_offset_[i];
+    auto neighbors_end = adj_array_.begin() + start_offset_[i + 1];
 
-    // sort neighbors by ascending order of label first, and descending order of
-    // degree second
-    std::sort(neighbors.begin(), neighbors.end(), [this](Vertex u, Vertex v) {
+    // sort neighbors by ascending order of label first, and ascending order of
+    // id second, so that each label range is a sorted set (see IsNeighbor and
+    // IntersectNeighbors)
+    std::sort(neighbors_begin, neighbors_end, [this](Vertex u, Vertex v) {
       if (GetLabel(u) != GetLabel(v))
         return GetLabel(u) < GetLabel(v);
-      else if (GetDegree(u) != GetDegree(v))
-        return GetDegree(u) > GetDegree(v);
       else
         return u < v;
     });
-
-    Vertex v = neighbors[0];
-    Label l = GetLabel(v);
-
-    start_offset_by_label_[i * (max_label_ + 1) + l].first = start_offset_[i];
-
-    for (size_t j = 1; j < neighbors.size(); ++j) {
-      v = neighbors[j];
-      Label next_l = GetLabel(v);
-
-      if (l != next_l) {
-        start_offset_by_label_[i * (max_label_ + 1) + l].second =
-            start_offset_[i] + j;
-        start_offset_by_label_[i * (max_label_ + 1) + next_l].first =
-            start_offset_[i] + j;
-        l = next_l;
-      }
-    }
-
-    start_offset_by_label_[i * (max_label_ + 1) + l].second =
-        start_offset_[i + 1];
-
-    std::copy(adj_list[i].begin(), adj_list[i].end(),
-              adj_array_.begin() + start_offset_[i]);
   }
+
+  BuildLabelIndex(dense_label_index);
 }
 
 /*
@@ -180,25 +134,25 @@ Graph::Graph(const std::string &filename, bool is_query) {
  * dag.cc overrides this
  */
 Graph::Graph(const std::string &filename, const CandidateSet &candidateSet, bool is_query) {
+    GraphFile file;
+    ReadGraph(filename, file);
+    //the root is chosen by the candidates of every vertex
+    if (file.num_vertices != candidateSet.GetNumQueryVertices())
+        throw std::runtime_error("Candidate set has " +
+                                 std::to_string(candidateSet.GetNumQueryVertices()) +
+                                 " query vertices, query graph " + filename + " has " +
+                                 std::to_string(file.num_vertices));
+
     if (!is_query) {
         //if !is_query, transferred_label array was not initialized.
-        TransferLabel(filename);
+        TransferLabel(file.labels);
     }
 
     std::vector<std::pair<double, Vertex>> priority;
-
-    // Load Graph
-    std::ifstream fin(filename);
     std::set<Label> label_set;
 
-    if (!fin.is_open()) {
-        std::cout << "Graph file " << filename << " not found!\n";
-        exit(EXIT_FAILURE);
-    }
-
-    char type;
-
-    fin >> type >> graph_id_ >> num_vertices_;
+    graph_id_ = file.graph_id;
+    num_vertices_ = file.num_vertices;
 
     dag_adj.resize(num_vertices_);
     parents.resize(num_vertices_);
@@ -208,30 +162,16 @@ Graph::Graph(const std::string &filename, const CandidateSet &candidateSet, bool
 
     num_edges_ = 0;
 
-    // preprocessing
-    while (fin >> type) {
-        if (type == 'v') {
-            Vertex id;
-            Label l;
-            fin >> id >> l;
-
-            if (static_cast<size_t>(l) >= transferred_label.size())
-                l = -1;
-            else
-                l = transferred_label[l];
-
-            label_[id] = l;
-            label_set.insert(l);
-        } else if (type == 'e') {
-            Vertex v1, v2;
-            Label l;
-            fin >> v1 >> v2 >> l;
-
-            dag_adj[v1].push_back(v2);
-            dag_adj[v2].push_back(v1);
+    for (size_t v = 0; v < num_vertices_; v++) {
+        Label l = Transferred(file.labels[v]);
+        label_[v] = l;
+        label_set.insert(l);
+    }
+    for (const std::pair<Vertex, Vertex> &e : file.edges) {
+        dag_adj[e.first].push_back(e.second);
+        dag_adj[e.second].push_back(e.first);
 
-            num_edges_ += 2;
-        }
+        num_edges_ += 2;
     }
 
 
@@ -285,8 +225,6 @@ Graph::Graph(const std::string &filename, const CandidateSet &candidateSet, bool
      }
 
 
-    fin.close();
-
     adj_array_.resize(num_edges_);
 
     num_labels_ = label_set.size();
@@ -295,8 +233,6 @@ Graph::Graph(const std::string &filename, const CandidateSet &candidateSet, bool
 
     label_frequency_.resize(max_label_ + 1);
 
-    start_offset_by_label_.resize(num_vertices_ * (max_label_ + 1));
-
     start_offset_[0] = 0;
 
     for (size_t i = 0; i < dag_adj.size(); ++i) {
@@ -312,41 +248,97 @@ Graph::Graph(const std::string &filename, const CandidateSet &candidateSet, bool
 
         if (neighbors.size() == 0) continue;
 
-        // sort neighbors by ascending order of label first, and descending order of
-        // degree second
+        // sort neighbors by ascending order of label first, and ascending order of
+        // id second
         std::sort(neighbors.begin(), neighbors.end(), [this](Vertex u, Vertex v) {
             if (GetLabel(u) != GetLabel(v))
                 return GetLabel(u) < GetLabel(v);
-            else if (GetDegree(u) != GetDegree(v))
-                return GetDegree(u) > GetDegree(v);
             else
                 return u < v;
         });
 
-        Vertex v = neighbors[0];
-        Label l = GetLabel(v);
+        std::copy(dag_adj[i].begin(), dag_adj[i].end(),
+                  adj_array_.begin() + start_offset_[i]);
+    }
+
+    BuildLabelIndex(false);
+}
 
-        start_offset_by_label_[i * (max_label_ + 1) + l].first = start_offset_[i];
+Graph::~Graph() {}
 
-        for (size_t j = 1; j < neighbors.size(); ++j) {
-            v = neighbors[j];
-            Label next_l = GetLabel(v);
+/*builds the label directory from the sorted neighbors, and the dense table
+if it is requested*/
+void Graph::BuildLabelIndex(bool dense_label_index) {
+  std::vector<size_t> run_offset(num_vertices_ + 1, 0);
+  std::vector<Label> run_label;
+  std::vector<uint32_t> run_start;
+  run_label.reserve(num_vertices_);
+  run_start.reserve(num_vertices_);
+
+  for (size_t v = 0; v < num_vertices_; ++v) {
+    for (size_t j = start_offset_[v]; j < start_offset_[v + 1]; ++j) {
+      Label l = GetLabel(adj_array_[j]);
+      if (j == start_offset_[v] || l != run_label.back()) {
+        run_label.push_back(l);
+        run_start.push_back(j - start_offset_[v]);
+      }
+    }
+    run_label.push_back(INT32_MAX);
+    run_start.push_back(GetDegree(v));
+    run_offset[v + 1] = run_label.size();
+  }
 
-            if (l != next_l) {
-                start_offset_by_label_[i * (max_label_ + 1) + l].second =
-                        start_offset_[i] + j;
-                start_offset_by_label_[i * (max_label_ + 1) + next_l].first =
-                        start_offset_[i] + j;
-                l = next_l;
-            }
-        }
+  label_run_offset_.assign(run_offset.begin(), run_offset.end());
+  run_label_.assign(run_label.begin(), run_label.end());
+  run_start_.assign(run_start.begin(), run_start.end());
 
-        start_offset_by_label_[i * (max_label_ + 1) + l].second =
-                start_offset_[i + 1];
+  if (dense_label_index) BuildDenseLabelIndex();
+}
 
-        std::copy(dag_adj[i].begin(), dag_adj[i].end(),
-                  adj_array_.begin() + start_offset_[i]);
+/*fills the dense table from the label directory. a label v has no neighbor
+with gets the empty range at the start of the next run, which is the sentinel
+run at the end of the neighbors of v after the last label*/
+void Graph::BuildDenseLabelIndex() {
+  start_offset_by_label_.resize(num_vertices_ * (max_label_ + 1));
+  for (size_t v = 0; v < num_vertices_; ++v) {
+    size_t k = label_run_offset_[v];
+    size_t sentinel = label_run_offset_[v + 1] - 1;
+    for (Label l = 0; l <= max_label_; ++l) {
+      while (k < sentinel && run_label_[k] < l) ++k;
+      size_t start = start_offset_[v] + run_start_[k];
+      size_t end = k < sentinel && run_label_[k] == l
+                       ? start_offset_[v] + run_start_[k + 1]
+                       : start;
+      start_offset_by_label_[v * (max_label_ + 1) + l] =
+          std::make_pair(start, end);
     }
+  }
 }
 
-Graph::~Graph() {}
+/**
+ * @brief Builds the edge index, so that IsNeighbor takes expected constant
+ * time. Costs about 16 bytes per edge; the search does not test edges one by
+ * one, so only callers that do should build it.
+ */
+void Graph::BuildEdgeIndex() { edge_index_ = EdgeIndex(*this); }
+
+/**
+ * @brief Writes the vertices of candidates that are neighbors of v with label
+ * l to out, and returns their number. The neighbor range of v with label l is
+ * sorted by id, so this is one sorted-set intersection instead of an
+ * IsNeighbor call per candidate.
+ *
+ * @param v vertex id.
+ * @param l label id of v's neighbor.
+ * @param candidates vertex ids sorted in ascending order without duplicates.
+ * @param size number of candidates.
+ * @param out room for size vertices, may be candidates itself.
+ * @return size_t
+ */
+size_t Graph::IntersectNeighbors(Vertex v, Label l, const Vertex *candidates,
+                                 size_t size, Vertex *out) const {
+  if (l < 0 || l > max_label_) return 0;
+  std::pair<size_t, size_t> range = GetNeighborRange(v, l);
+  return IntersectSorted(candidates, size, adj_array_.data() + range.first,
+                         range.second - range.first, out);
+}
@@ -0,0 +1,196 @@
+/**
+ * @file graph_reader.cc
+ *
+ */
+
+#include "graph_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <thread>
+
+namespace {
+
+/*files smaller than this are parsed by one thread*/
+const size_t kMinChunkSize = 4 << 20;
+
+/*integer scanner over a memory range, in place of ifstream >>*/
+class Scanner {
+ public:
+  Scanner(const char *begin, const char *end) : p_(begin), end_(end) {}
+
+  /*skips whitespace and returns the next character, or 0 at the end*/
+  char NextChar() {
+    SkipSpace();
+    return p_ < end_ ? *p_++ : 0;
+  }
+
+  /*false if there is no integer, or it does not fit in int64_t*/
+  bool NextInt(int64_t &value) {
+    SkipSpace();
+    bool negative = false;
+    if (p_ < end_ && *p_ == '-') {
+      negative = true;
+      ++p_;
+    }
+    if (p_ == end_ || *p_ < '0' || *p_ > '9') return false;
+    int64_t x = 0;
+    while (p_ < end_ && *p_ >= '0' && *p_ <= '9') {
+      int digit = *p_++ - '0';
+      if (x > (std::numeric_limits<int64_t>::max() - digit) / 10) return false;
+      x = x * 10 + digit;
+    }
+    value = negative ? -x : x;
+    return true;
+  }
+
+  void SkipLine() {
+    while (p_ < end_ && *p_ != '\n') ++p_;
+  }
+
+  const char *Position() const { return p_; }
+
+ private:
+  void SkipSpace() {
+    while (p_ < end_ && (*p_ == ' ' || *p_ == '\n' || *p_ == '\r' ||
+                         *p_ == '\t'))
+      ++p_;
+  }
+
+  const char *p_;
+  const char *end_;
+};
+
+/*true if value fits in a Vertex or a Label*/
+bool FitsInt32(int64_t value) {
+  return value >= std::numeric_limits<int32_t>::min() &&
+         value <= std::numeric_limits<int32_t>::max();
+}
+
+/*parses the v and e lines of [begin, end), which starts at a line start.
+seen[v] is set by the chunk that has the v line of v, so that a duplicate is
+rejected and file.labels[v] is written by one chunk only*/
+bool ParseChunk(const char *begin, const char *end, GraphFile &file,
+                std::atomic<bool> *seen,
+                std::vector<std::pair<Vertex, Vertex>> &edges) {
+  Scanner scanner(begin, end);
+  int64_t num_vertices = file.num_vertices;
+  char type;
+
+  while ((type = scanner.NextChar()) != 0) {
+    if (type == 'v') {
+      int64_t id, label;
+      if (!scanner.NextInt(id) || !scanner.NextInt(label)) return false;
+      if (id < 0 || id >= num_vertices || !FitsInt32(label)) return false;
+      if (seen[id].exchange(true, std::memory_order_relaxed)) return false;
+      file.labels[id] = label;
+    } else if (type == 'e') {
+      int64_t v1, v2, label;
+      if (!scanner.NextInt(v1) || !scanner.NextInt(v2) ||
+          !scanner.NextInt(label))
+        return false;
+      if (v1 < 0 || v1 >= num_vertices || v2 < 0 || v2 >= num_vertices)
+        return false;
+      edges.push_back(std::make_pair(v1, v2));
+    } else {
+      scanner.SkipLine();
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+/**
+ * @brief Reads an .igraph file in one pass over its mmap-ed contents. Large
+ * files are split on line boundaries and the chunks are parsed in parallel.
+ * Edges are kept in file order.
+ *
+ * @param filename
+ * @param file output.
+ * @return bool false if the file cannot be opened or is malformed: a vertex
+ * appears twice, or an id or a label does not fit in 32 bits.
+ */
+bool ReadGraphFile(const std::string &filename, GraphFile &file) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return false;
+  }
+  size_t size = st.st_size;
+
+  void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) return false;
+  madvise(mapped, size, MADV_SEQUENTIAL);
+
+  const char *begin = static_cast<const char *>(mapped);
+  const char *end = begin + size;
+
+  Scanner header(begin, end);
+  int64_t graph_id, num_vertices;
+  bool ok = header.NextChar() == 't' && header.NextInt(graph_id) &&
+            header.NextInt(num_vertices) && FitsInt32(graph_id) &&
+            num_vertices >= 0 && FitsInt32(num_vertices);
+
+  if (ok) {
+    file.graph_id = graph_id;
+    file.num_vertices = num_vertices;
+    file.labels.assign(num_vertices, -1);
+    file.edges.clear();
+
+    const char *body = header.Position();
+
+    size_t num_chunks = (end - body) / kMinChunkSize;
+    size_t max_chunks = std::thread::hardware_concurrency();
+    if (num_chunks > max_chunks) num_chunks = max_chunks;
+    if (num_chunks == 0) num_chunks = 1;
+
+    /*chunk boundaries are moved forward to the next line start*/
+    std::vector<const char *> bounds(num_chunks + 1, end);
+    bounds[0] = body;
+    for (size_t i = 1; i < num_chunks; ++i) {
+      const char *p = body + (end - body) * i / num_chunks;
+      if (p < bounds[i - 1]) p = bounds[i - 1];
+      while (p < end && *p != '\n') ++p;
+      bounds[i] = p;
+    }
+
+    std::vector<std::vector<std::pair<Vertex, Vertex>>> edges(num_chunks);
+    std::unique_ptr<std::atomic<bool>[]> seen(
+        new std::atomic<bool>[num_vertices]());
+    std::atomic<bool> chunks_ok(true);
+    auto parse = [&](size_t i) {
+      if (!ParseChunk(bounds[i], bounds[i + 1], file, seen.get(), edges[i]))
+        chunks_ok = false;
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < num_chunks; ++i) threads.push_back(std::thread(parse, i));
+    parse(0);
+    for (std::thread &t : threads) t.join();
+    ok = chunks_ok;
+
+    if (num_chunks == 1) {
+      file.edges.swap(edges[0]);
+    } else {
+      size_t num_edges = 0;
+      for (auto &chunk : edges) num_edges += chunk.size();
+      file.edges.reserve(num_edges);
+      for (auto &chunk : edges)
+        file.edges.insert(file.edges.end(), chunk.begin(), chunk.end());
+    }
+  }
+
+  munmap(mapped, size);
+  return ok;
+}
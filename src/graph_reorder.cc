@@ -0,0 +1,142 @@
+/**
+ * @file graph_reorder.cc
+ * @brief renumbering of the data graph for locality
+ *
+ */
+
+#include "graph.h"
+#include "graph_reader.h"
+
+namespace {
+
+/*degree of every vertex of the file*/
+std::vector<size_t> Degrees(const GraphFile &file) {
+  std::vector<size_t> degree(file.num_vertices, 0);
+  for (const std::pair<Vertex, Vertex> &e : file.edges) {
+    degree[e.first]++;
+    degree[e.second]++;
+  }
+  return degree;
+}
+
+/*vertices grouped by label, and by descending degree within a label, so that
+the candidates of a query vertex are a few dense id ranges*/
+std::vector<Vertex> LabelDegreeSequence(const GraphFile &file) {
+  std::vector<size_t> degree = Degrees(file);
+  std::vector<Vertex> sequence(file.num_vertices);
+  for (size_t v = 0; v < file.num_vertices; ++v) sequence[v] = v;
+  std::sort(sequence.begin(), sequence.end(), [&](Vertex u, Vertex v) {
+    if (file.labels[u] != file.labels[v])
+      return file.labels[u] < file.labels[v];
+    if (degree[u] != degree[v]) return degree[u] > degree[v];
+    return u < v;
+  });
+  return sequence;
+}
+
+/*Cuthill-McKee: breadth-first from a vertex of the smallest degree, visiting
+the neighbors of a vertex in ascending order of degree, so that neighbors get
+nearby ids*/
+std::vector<Vertex> BFSSequence(const GraphFile &file) {
+  size_t n = file.num_vertices;
+  std::vector<size_t> degree = Degrees(file);
+
+  std::vector<size_t> offset(n + 1, 0);
+  for (size_t v = 0; v < n; ++v) offset[v + 1] = offset[v] + degree[v];
+  std::vector<Vertex> adj(offset[n]);
+  {
+    std::vector<size_t> cursor(offset.begin(), offset.end() - 1);
+    for (const std::pair<Vertex, Vertex> &e : file.edges) {
+      adj[cursor[e.first]++] = e.second;
+      adj[cursor[e.second]++] = e.first;
+    }
+  }
+
+  auto by_degree = [&](Vertex u, Vertex v) {
+    return degree[u] != degree[v] ? degree[u] < degree[v] : u < v;
+  };
+  std::vector<Vertex> starts(n);
+  for (size_t v = 0; v < n; ++v) starts[v] = v;
+  std::sort(starts.begin(), starts.end(), by_degree);
+
+  std::vector<Vertex> sequence;
+  sequence.reserve(n);
+  std::vector<bool> visited(n, false);
+  // every component is started from its vertex of the smallest degree
+  for (Vertex start : starts) {
+    if (visited[start]) continue;
+    visited[start] = true;
+    size_t head = sequence.size();
+    sequence.push_back(start);
+    while (head < sequence.size()) {
+      Vertex v = sequence[head++];
+      std::sort(adj.begin() + offset[v], adj.begin() + offset[v + 1],
+                by_degree);
+      for (size_t j = offset[v]; j < offset[v + 1]; ++j) {
+        if (visited[adj[j]]) continue;
+        visited[adj[j]] = true;
+        sequence.push_back(adj[j]);
+      }
+    }
+  }
+  return sequence;
+}
+
+}  // namespace
+
+/**
+ * @brief Parses the name of a vertex order given on the command line: input,
+ * label or bfs.
+ *
+ * @param name
+ * @param order output.
+ * @return bool false if the name is unknown.
+ */
+bool ParseVertexOrder(const std::string &name, VertexOrder &order) {
+  if (name == "input")
+    order = kInputOrder;
+  else if (name == "label")
+    order = kLabelDegreeOrder;
+  else if (name == "bfs")
+    order = kBFSOrder;
+  else
+    return false;
+  return true;
+}
+
+/*renumbers the vertices of the file in the given order, and keeps the ids of
+the file to translate them at the boundary*/
+void Graph::Reorder(GraphFile &file, VertexOrder order) {
+  std::vector<Vertex> sequence;
+  if (order == kLabelDegreeOrder)
+    sequence = LabelDegreeSequence(file);
+  else if (order == kBFSOrder)
+    sequence = BFSSequence(file);
+  else
+    return;
+
+  original_id_.assign(sequence.begin(), sequence.end());
+  BuildInternalIds();  // a permutation by construction
+
+  std::vector<Label> labels(file.num_vertices);
+  for (size_t v = 0; v < file.num_vertices; ++v)
+    labels[v] = file.labels[original_id_[v]];
+  file.labels.swap(labels);
+  for (std::pair<Vertex, Vertex> &e : file.edges) {
+    e.first = internal_id_[e.first];
+    e.second = internal_id_[e.second];
+  }
+}
+
+/*inverts original_id_, false if it is not a permutation of the vertices*/
+bool Graph::BuildInternalIds() {
+  size_t n = original_id_.size();
+  internal_id_.assign(n, -1);
+  for (size_t v = 0; v < n; ++v) {
+    Vertex id = original_id_[v];
+    if (id < 0 || static_cast<size_t>(id) >= n || internal_id_[id] != -1)
+      return false;
+    internal_id_[id] = v;
+  }
+  return true;
+}
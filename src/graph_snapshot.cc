@@ -0,0 +1,323 @@
+/**
+ * @file graph_snapshot.cc
+ * @brief binary CSR snapshot of a data graph
+ *
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "graph.h"
+
+namespace {
+
+/*
+ * Layout of a snapshot file: the header, then every section at a 64-byte
+ * aligned offset. Sections hold the arrays of Graph as they are in memory, so
+ * the file can be used in place once it is mapped. Any change of the layout
+ * must increase kSnapshotVersion.
+ */
+const char kSnapshotMagic[8] = {'I', 'G', 'R', 'A', 'P', 'H', 'S', 'N'};
+const uint32_t kSnapshotVersion = 3;
+const uint32_t kByteOrderMark = 0x01020304;
+const size_t kSectionAlignment = 64;
+
+enum Section {
+  kLabelFrequency,
+  kStartOffset,
+  kLabelRunOffset,
+  kRunLabel,
+  kRunStart,
+  kLabels,
+  kAdjArray,
+  kLabelTransfer,
+  kOriginalId,
+  kNumSections
+};
+
+struct SnapshotSection {
+  uint64_t offset;  /*byte offset from the start of the file*/
+  uint64_t count;   /*# of elements*/
+};
+
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  int32_t graph_id;
+  int32_t max_label;
+  uint64_t num_vertices;
+  uint64_t num_edges;
+  uint64_t num_labels;
+  uint64_t element_size[kNumSections];
+  SnapshotSection sections[kNumSections];
+};
+
+static_assert(sizeof(size_t) == sizeof(uint64_t),
+              "snapshots store size_t arrays as 64-bit integers");
+
+bool WriteAll(int fd, const void *data, size_t size) {
+  const char *p = static_cast<const char *>(data);
+  while (size > 0) {
+    ssize_t written = write(fd, p, size);
+    if (written <= 0) return false;
+    p += written;
+    size -= written;
+  }
+  return true;
+}
+
+template <typename T>
+const T *SectionData(const SnapshotHeader &header, const char *base,
+                     Section section) {
+  return reinterpret_cast<const T *>(base + header.sections[section].offset);
+}
+
+/*checks that the arrays of a mapped snapshot, whose section sizes are already
+checked, agree with each other, so that no lookup in a corrupted file reads
+outside of them*/
+bool ValidArrays(const SnapshotHeader &header, const char *base) {
+  const SnapshotSection *sections = header.sections;
+  size_t n = header.num_vertices;
+  if (n > static_cast<size_t>(INT32_MAX) || header.max_label < 0 ||
+      sections[kLabelFrequency].count !=
+          static_cast<size_t>(header.max_label) + 1 ||
+      header.num_labels > sections[kLabelFrequency].count)
+    return false;
+
+  const Label *label = SectionData<Label>(header, base, kLabels);
+  for (size_t v = 0; v < n; ++v)
+    if (label[v] < 0 || label[v] > header.max_label) return false;
+
+  const Label *transfer = SectionData<Label>(header, base, kLabelTransfer);
+  for (size_t l = 0; l < sections[kLabelTransfer].count; ++l)
+    if (transfer[l] < -1 || transfer[l] > header.max_label) return false;
+
+  // neighbors: within the array, and sorted by (label, id) in every list
+  const size_t *start = SectionData<size_t>(header, base, kStartOffset);
+  const Vertex *adj = SectionData<Vertex>(header, base, kAdjArray);
+  if (start[0] != 0 || start[n] != 2 * header.num_edges) return false;
+  for (size_t v = 0; v < n; ++v) {
+    if (start[v] > start[v + 1]) return false;
+    for (size_t j = start[v]; j < start[v + 1]; ++j) {
+      if (adj[j] < 0 || static_cast<size_t>(adj[j]) >= n) return false;
+      if (j > start[v] &&
+          std::make_pair(label[adj[j - 1]], adj[j - 1]) >=
+              std::make_pair(label[adj[j]], adj[j]))
+        return false;
+    }
+  }
+
+  // label runs: sorted labels ending with the sentinel, starts within the
+  // degree
+  const size_t *run_offset = SectionData<size_t>(header, base, kLabelRunOffset);
+  const Label *run_label = SectionData<Label>(header, base, kRunLabel);
+  const uint32_t *run_start = SectionData<uint32_t>(header, base, kRunStart);
+  if (run_offset[0] != 0) return false;
+  for (size_t v = 0; v < n; ++v) {
+    size_t first = run_offset[v], last = run_offset[v + 1];
+    size_t degree = start[v + 1] - start[v];
+    if (first >= last || last > sections[kRunLabel].count ||
+        run_label[last - 1] != INT32_MAX || run_start[last - 1] != degree)
+      return false;
+    for (size_t k = first; k + 1 < last; ++k) {
+      if (run_label[k] < 0 || run_label[k] > header.max_label ||
+          (k > first && run_label[k - 1] >= run_label[k]) ||
+          run_start[k] > run_start[k + 1])
+        return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+/**
+ * @brief Returns true if the file starts with the magic bytes of a snapshot.
+ *
+ * @param filename
+ * @return bool
+ */
+bool Graph::IsSnapshot(const std::string &filename) {
+  std::ifstream fin(filename, std::ios::binary);
+  char magic[sizeof(kSnapshotMagic)];
+  if (!fin.read(magic, sizeof(magic))) return false;
+  return std::memcmp(magic, kSnapshotMagic, sizeof(magic)) == 0;
+}
+
+/**
+ * @brief Writes the graph, together with the label transfer table of the data
+ * graph, as a snapshot file that the constructor maps instead of parsing. The
+ * dense label table is not written; it is rebuilt on load if requested.
+ * The file is written next to the target and renamed over it, so that
+ * processes that have the old snapshot mapped keep reading it unchanged.
+ *
+ * @param filename
+ * @return bool false if the file cannot be written.
+ */
+bool Graph::SaveSnapshot(const std::string &filename) const {
+  SnapshotHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+  header.version = kSnapshotVersion;
+  header.byte_order = kByteOrderMark;
+  header.graph_id = graph_id_;
+  header.max_label = max_label_;
+  header.num_vertices = num_vertices_;
+  header.num_edges = num_edges_;
+  header.num_labels = num_labels_;
+
+  const void *data[kNumSections] = {
+      label_frequency_.data(), start_offset_.data(),
+      label_run_offset_.data(), run_label_.data(),
+      run_start_.data(),        label_.data(),
+      adj_array_.data(),        transferred_label_.data(),
+      original_id_.data()};
+  header.element_size[kLabelFrequency] = sizeof(size_t);
+  header.element_size[kStartOffset] = sizeof(size_t);
+  header.element_size[kLabelRunOffset] = sizeof(size_t);
+  header.element_size[kRunLabel] = sizeof(Label);
+  header.element_size[kRunStart] = sizeof(uint32_t);
+  header.element_size[kLabels] = sizeof(Label);
+  header.element_size[kAdjArray] = sizeof(Vertex);
+  header.element_size[kLabelTransfer] = sizeof(Label);
+  header.element_size[kOriginalId] = sizeof(Vertex);
+  header.sections[kLabelFrequency].count = label_frequency_.size();
+  header.sections[kStartOffset].count = start_offset_.size();
+  header.sections[kLabelRunOffset].count = label_run_offset_.size();
+  header.sections[kRunLabel].count = run_label_.size();
+  header.sections[kRunStart].count = run_start_.size();
+  header.sections[kLabels].count = label_.size();
+  header.sections[kAdjArray].count = adj_array_.size();
+  header.sections[kLabelTransfer].count = transferred_label_.size();
+  header.sections[kOriginalId].count = original_id_.size();
+
+  uint64_t offset = sizeof(header);
+  for (int i = 0; i < kNumSections; ++i) {
+    offset = (offset + kSectionAlignment - 1) / kSectionAlignment *
+             kSectionAlignment;
+    header.sections[i].offset = offset;
+    offset += header.sections[i].count * header.element_size[i];
+  }
+
+  std::string temporary = filename + ".tmp";
+  int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return false;
+
+  bool ok = WriteAll(fd, &header, sizeof(header));
+  uint64_t written = sizeof(header);
+  const char padding[kSectionAlignment] = {0};
+  for (int i = 0; i < kNumSections && ok; ++i) {
+    ok = WriteAll(fd, padding, header.sections[i].offset - written);
+    uint64_t size = header.sections[i].count * header.element_size[i];
+    ok = ok && WriteAll(fd, data[i], size);
+    written = header.sections[i].offset + size;
+  }
+
+  ok = close(fd) == 0 && ok;
+  if (ok) ok = std::rename(temporary.c_str(), filename.c_str()) == 0;
+  if (!ok) std::remove(temporary.c_str());
+  return ok;
+}
+
+/*maps the snapshot and makes the arrays view it, without copying*/
+bool Graph::LoadSnapshot(const std::string &filename, bool dense_label_index) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader)) {
+    close(fd);
+    return false;
+  }
+  size_t size = st.st_size;
+
+  void *mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) return false;
+  snapshot_ = std::shared_ptr<void>(mapped, [size](void *p) { munmap(p, size); });
+
+  const char *base = static_cast<const char *>(mapped);
+  SnapshotHeader header;
+  std::memcpy(&header, base, sizeof(header));
+
+  if (std::memcmp(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0 ||
+      header.version != kSnapshotVersion ||
+      header.byte_order != kByteOrderMark)
+    return false;
+
+  const uint64_t element_size[kNumSections] = {
+      sizeof(size_t), sizeof(size_t), sizeof(size_t), sizeof(Label),
+      sizeof(uint32_t), sizeof(Label), sizeof(Vertex), sizeof(Label),
+      sizeof(Vertex)};
+  for (int i = 0; i < kNumSections; ++i) {
+    const SnapshotSection &section = header.sections[i];
+    if (header.element_size[i] != element_size[i] ||
+        section.offset % kSectionAlignment != 0 || section.offset > size ||
+        section.count > (size - section.offset) / element_size[i])
+      return false;
+  }
+  if (header.sections[kStartOffset].count != header.num_vertices + 1 ||
+      header.sections[kLabels].count != header.num_vertices ||
+      header.sections[kAdjArray].count != header.num_edges * 2 ||
+      header.sections[kLabelRunOffset].count != header.num_vertices + 1 ||
+      header.sections[kRunStart].count != header.sections[kRunLabel].count ||
+      (header.sections[kOriginalId].count != 0 &&
+       header.sections[kOriginalId].count != header.num_vertices))
+    return false;
+
+  const SnapshotSection *sections = header.sections;
+  const size_t *run_offset = SectionData<size_t>(header, base, kLabelRunOffset);
+  if (run_offset[header.num_vertices] != sections[kRunLabel].count ||
+      !ValidArrays(header, base))
+    return false;
+
+  graph_id_ = header.graph_id;
+  max_label_ = header.max_label;
+  num_vertices_ = header.num_vertices;
+  num_edges_ = header.num_edges;
+  num_labels_ = header.num_labels;
+
+  label_frequency_.View(
+      reinterpret_cast<const size_t *>(base + sections[kLabelFrequency].offset),
+      sections[kLabelFrequency].count);
+  start_offset_.View(
+      reinterpret_cast<const size_t *>(base + sections[kStartOffset].offset),
+      sections[kStartOffset].count);
+  label_run_offset_.View(run_offset, sections[kLabelRunOffset].count);
+  run_label_.View(
+      reinterpret_cast<const Label *>(base + sections[kRunLabel].offset),
+      sections[kRunLabel].count);
+  run_start_.View(
+      reinterpret_cast<const uint32_t *>(base + sections[kRunStart].offset),
+      sections[kRunStart].count);
+  label_.View(reinterpret_cast<const Label *>(base + sections[kLabels].offset),
+              sections[kLabels].count);
+  adj_array_.View(
+      reinterpret_cast<const Vertex *>(base + sections[kAdjArray].offset),
+      sections[kAdjArray].count);
+
+  original_id_.View(
+      reinterpret_cast<const Vertex *>(base + sections[kOriginalId].offset),
+      sections[kOriginalId].count);
+  // the original ids are checked while they are inverted
+  if (IsReordered() && !BuildInternalIds()) return false;
+
+  const Label *transfer =
+      reinterpret_cast<const Label *>(base + sections[kLabelTransfer].offset);
+  transferred_label_.assign(transfer,
+                            transfer + sections[kLabelTransfer].count);
+  unknown_label_ = 0;
+  for (Label l : transferred_label_)
+    if (l != -1) unknown_label_++;
+
+  if (dense_label_index) BuildDenseLabelIndex();
+  return true;
+}
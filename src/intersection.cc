@@ -0,0 +1,137 @@
+/**
+ * @file intersection.cc
+ *
+ */
+
+#include "intersection.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/*galloping is used when one side is this many times longer than the other*/
+const size_t kGallopRatio = 32;
+
+/*first position in [begin, size) with a[pos] >= key, by exponential search*/
+template <typename T>
+size_t Gallop(const T *a, size_t begin, size_t size, T key) {
+  size_t step = 1;
+  size_t low = begin, high = begin;
+  while (high < size && a[high] < key) {
+    low = high + 1;
+    high += step;
+    step <<= 1;
+  }
+  if (high > size) high = size;
+  return std::lower_bound(a + low, a + high, key) - a;
+}
+
+template <typename T>
+size_t IntersectGallop(const T *a, size_t a_size, const T *b, size_t b_size,
+                       T *out) {
+  /*elements of the smaller side are searched in the larger side*/
+  size_t count = 0;
+  if (a_size <= b_size) {
+    size_t j = 0;
+    for (size_t i = 0; i < a_size && j < b_size; ++i) {
+      j = Gallop(b, j, b_size, a[i]);
+      if (j < b_size && b[j] == a[i]) out[count++] = a[i];
+    }
+  } else {
+    size_t i = 0;
+    for (size_t j = 0; j < b_size && i < a_size; ++j) {
+      i = Gallop(a, i, a_size, b[j]);
+      if (i < a_size && a[i] == b[j]) out[count++] = b[j];
+    }
+  }
+  return count;
+}
+
+template <typename T>
+size_t IntersectMerge(const T *a, size_t a_size, const T *b, size_t b_size,
+                      T *out) {
+  size_t count = 0, i = 0, j = 0;
+
+#if defined(__AVX2__)
+  /*compare 8 elements of a with every rotation of 8 elements of b*/
+  const __m256i rotate = _mm256_set_epi32(0, 7, 6, 5, 4, 3, 2, 1);
+  while (i + 8 <= a_size && j + 8 <= b_size) {
+    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+    __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + j));
+    __m256i match = _mm256_cmpeq_epi32(va, vb);
+    for (int r = 1; r < 8; ++r) {
+      vb = _mm256_permutevar8x32_epi32(vb, rotate);
+      match = _mm256_or_si256(match, _mm256_cmpeq_epi32(va, vb));
+    }
+    int mask = _mm256_movemask_ps(_mm256_castsi256_ps(match));
+
+    T block[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(block), va);
+    for (int k = 0; k < 8; ++k)
+      if (mask & (1 << k)) out[count++] = block[k];
+
+    T a_last = a[i + 7], b_last = b[j + 7];
+    if (a_last <= b_last) i += 8;
+    if (b_last <= a_last) j += 8;
+  }
+#elif defined(__SSE2__)
+  /*compare 4 elements of a with every rotation of 4 elements of b*/
+  while (i + 4 <= a_size && j + 4 <= b_size) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + j));
+    __m128i match = _mm_cmpeq_epi32(va, vb);
+    match = _mm_or_si128(
+        match, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1))));
+    match = _mm_or_si128(
+        match, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+    match = _mm_or_si128(
+        match, _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3))));
+    int mask = _mm_movemask_ps(_mm_castsi128_ps(match));
+
+    T block[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(block), va);
+    for (int k = 0; k < 4; ++k)
+      if (mask & (1 << k)) out[count++] = block[k];
+
+    T a_last = a[i + 3], b_last = b[j + 3];
+    if (a_last <= b_last) i += 4;
+    if (b_last <= a_last) j += 4;
+  }
+#endif
+
+  while (i < a_size && j < b_size) {
+    if (a[i] < b[j]) {
+      ++i;
+    } else if (a[i] > b[j]) {
+      ++j;
+    } else {
+      out[count++] = a[i];
+      ++i;
+      ++j;
+    }
+  }
+  return count;
+}
+
+template <typename T>
+size_t Intersect(const T *a, size_t a_size, const T *b, size_t b_size,
+                 T *out) {
+  if (a_size == 0 || b_size == 0) return 0;
+  if (a_size * kGallopRatio < b_size || b_size * kGallopRatio < a_size)
+    return IntersectGallop(a, a_size, b, b_size, out);
+  return IntersectMerge(a, a_size, b, b_size, out);
+}
+
+}  // namespace
+
+size_t IntersectSorted(const int32_t *a, size_t a_size, const int32_t *b,
+                       size_t b_size, int32_t *out) {
+  return Intersect(a, a_size, b, b_size, out);
+}
+
+size_t IntersectSorted(const uint32_t *a, size_t a_size, const uint32_t *b,
+                       size_t b_size, uint32_t *out) {
+  return Intersect(a, a_size, b, b_size, out);
+}
@@ -0,0 +1,246 @@
+/**
+ * @file matching_order.cc
+ *
+ */
+
+#include "matching_order.h"
+
+namespace {
+
+/*neighbors of u in the query graph: its parents and children in the DAG*/
+std::vector<Vertex> QueryNeighbors(const Dag &query, Vertex u) {
+  std::vector<Vertex> neighbors;
+  for (size_t j = 0; j < query.GetParentSize(u); ++j)
+    neighbors.push_back(query.GetParent(u, j));
+  for (size_t j = 0; j < query.GetChildSize(u); ++j)
+    neighbors.push_back(query.GetChild(u, j));
+  return neighbors;
+}
+
+}  // namespace
+
+/**
+ * @brief Parses the name of an order given on the command line: candidate,
+ * path, gql or ri.
+ *
+ * @param name
+ * @param type output.
+ * @return bool false if the name is unknown.
+ */
+bool ParseOrderType(const std::string &name, OrderType &type) {
+  if (name == "candidate")
+    type = kCandidateSizeOrder;
+  else if (name == "path")
+    type = kPathSizeOrder;
+  else if (name == "gql")
+    type = kGQLOrder;
+  else if (name == "ri")
+    type = kRIOrder;
+  else
+    return false;
+  return true;
+}
+
+MatchingOrder::MatchingOrder(const Dag &query, const CandidateSet &cs,
+                             const CandidateSpace &space, OrderType type)
+    : type_(type), cs_(cs) {
+  switch (type_) {
+    case kPathSizeOrder:
+      ComputeWeights(query, cs, space);
+      break;
+    case kGQLOrder:
+      ComputeGQLRank(query, cs);
+      break;
+    case kRIOrder:
+      ComputeRIRank(query);
+      break;
+    default:
+      break;
+  }
+}
+
+MatchingOrder::~MatchingOrder() {}
+
+/**
+ * @brief Returns the key of the extendable vertex u. The vertex with the
+ * smallest key is matched first.
+ *
+ * @param u query vertex id.
+ * @param extendable extendable candidates of u, as indices in its candidate
+ * set.
+ * @param size # of extendable candidates.
+ * @return double
+ */
+double MatchingOrder::GetKey(Vertex u, const uint32_t *extendable,
+                             size_t size) const {
+  switch (type_) {
+    case kPathSizeOrder: {
+      size_t first = cs_.GetCandidateId(u, 0);
+      double sum = 0;
+      for (size_t k = 0; k < size; ++k) sum += weight_[first + extendable[k]];
+      return sum;
+    }
+    case kGQLOrder:
+    case kRIOrder:
+      return rank_[u];
+    default:
+      return size;
+  }
+}
+
+/*weight of a candidate v of u: 1 if u is a leaf of the DAG, otherwise the
+smallest, over the children c of u, sum of the weights of the candidates of c
+adjacent to v. computed from the leaves up*/
+void MatchingOrder::ComputeWeights(const Dag &query, const CandidateSet &cs,
+                                   const CandidateSpace &space) {
+  weight_.assign(cs.GetNumCandidates(), 1);
+
+  const std::vector<Vertex> &order = query.GetTopologicalOrder();
+  for (size_t k = order.size(); k-- > 0;) {
+    Vertex u = order[k];
+    if (query.GetChildSize(u) == 0) continue;
+
+    for (size_t i = 0; i < cs.GetCandidateSize(u); ++i) {
+      double weight = -1;
+      for (size_t c = 0; c < query.GetChildSize(u); ++c) {
+        Vertex child = query.GetChild(u, c);
+        size_t j = 0;
+        while (static_cast<Vertex>(query.GetParent(child, j)) != u) ++j;
+
+        const uint32_t *adjacent = space.GetEdgeCandidates(child, j, i);
+        size_t first = cs.GetCandidateId(child, 0);
+        double sum = 0;
+        for (size_t a = 0; a < space.GetEdgeCandidateSize(child, j, i); ++a)
+          sum += weight_[first + adjacent[a]];
+        if (weight < 0 || sum < weight) weight = sum;
+      }
+      weight_[cs.GetCandidateId(u, i)] = weight;
+    }
+  }
+}
+
+/*GraphQL: start from the vertex with the fewest candidates, then take the
+neighbor of the ordered vertices with the fewest candidates*/
+void MatchingOrder::ComputeGQLRank(const Dag &query, const CandidateSet &cs) {
+  size_t n = query.GetNumVertices();
+  std::vector<bool> selected(n, false), frontier(n, false);
+  std::vector<Vertex> order;
+
+  while (order.size() < n) {
+    Vertex next = -1;
+    for (int pass = 0; pass < 2 && next == -1; ++pass) {
+      // a disconnected query restarts from every vertex
+      for (size_t u = 0; u < n; ++u) {
+        if (selected[u] || (pass == 0 && !frontier[u])) continue;
+        if (next == -1 || cs.GetCandidateSize(u) < cs.GetCandidateSize(next))
+          next = u;
+      }
+    }
+
+    selected[next] = true;
+    order.push_back(next);
+    for (Vertex w : QueryNeighbors(query, next)) frontier[w] = true;
+  }
+  SetRank(order);
+}
+
+/*RI: start from the vertex of the largest degree, then take the vertex with
+the most neighbors among the ordered vertices, breaking ties by the # of its
+neighbors next to the ordered vertices, and then by its other neighbors*/
+void MatchingOrder::ComputeRIRank(const Dag &query) {
+  size_t n = query.GetNumVertices();
+  std::vector<std::vector<Vertex>> neighbors(n);
+  for (size_t u = 0; u < n; ++u) neighbors[u] = QueryNeighbors(query, u);
+
+  std::vector<bool> selected(n, false);
+  std::vector<size_t> num_selected_neighbors(n, 0);
+  std::vector<Vertex> order;
+
+  while (order.size() < n) {
+    Vertex next = -1;
+    size_t best[3] = {0, 0, 0};
+    for (size_t u = 0; u < n; ++u) {
+      if (selected[u]) continue;
+      size_t score[3] = {num_selected_neighbors[u], 0, 0};
+      for (Vertex w : neighbors[u]) {
+        if (selected[w]) continue;
+        if (num_selected_neighbors[w] > 0)
+          score[1]++;
+        else
+          score[2]++;
+      }
+      if (next == -1 || std::lexicographical_compare(best, best + 3, score,
+                                                     score + 3)) {
+        next = u;
+        std::copy(score, score + 3, best);
+      }
+    }
+
+    selected[next] = true;
+    order.push_back(next);
+    for (Vertex w : neighbors[next]) num_selected_neighbors[w]++;
+  }
+  SetRank(order);
+}
+
+void MatchingOrder::SetRank(const std::vector<Vertex> &order) {
+  rank_.resize(order.size());
+  for (size_t k = 0; k < order.size(); ++k) rank_[order[k]] = k;
+}
+
+VertexHeap::VertexHeap(size_t num_vertices)
+    : heap_(num_vertices), size_(0), position_(num_vertices, -1) {}
+
+/**
+ * @brief Adds u, which is not in the heap, with the key.
+ *
+ * @param u query vertex id.
+ * @param key
+ */
+void VertexHeap::Push(Vertex u, double key) {
+  SiftUp(size_++, std::make_pair(key, u));
+}
+
+/**
+ * @brief Removes u from the heap, if it is in the heap.
+ *
+ * @param u query vertex id.
+ */
+void VertexHeap::Remove(Vertex u) {
+  int32_t i = position_[u];
+  if (i == -1) return;
+  position_[u] = -1;
+
+  std::pair<double, Vertex> last = heap_[--size_];
+  if (static_cast<size_t>(i) == size_) return;
+  if (last < heap_[i])
+    SiftUp(i, last);
+  else
+    SiftDown(i, last);
+}
+
+void VertexHeap::Place(size_t i, const std::pair<double, Vertex> &entry) {
+  heap_[i] = entry;
+  position_[entry.second] = i;
+}
+
+/*moves entry from the empty slot i towards the top*/
+void VertexHeap::SiftUp(size_t i, std::pair<double, Vertex> entry) {
+  while (i > 0 && entry < heap_[(i - 1) / 2]) {
+    Place(i, heap_[(i - 1) / 2]);
+    i = (i - 1) / 2;
+  }
+  Place(i, entry);
+}
+
+/*moves entry from the empty slot i towards the bottom*/
+void VertexHeap::SiftDown(size_t i, std::pair<double, Vertex> entry) {
+  while (2 * i + 1 < size_) {
+    size_t child = 2 * i + 1;
+    if (child + 1 < size_ && heap_[child + 1] < heap_[child]) ++child;
+    if (!(heap_[child] < entry)) break;
+    Place(i, heap_[child]);
+    i = child;
+  }
+  Place(i, entry);
+}
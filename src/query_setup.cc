@@ -0,0 +1,105 @@
+/**
+ * @file query_setup.cc
+ *
+ */
+
+#include "query_setup.h"
+
+#include <chrono>
+
+/*the defaults of main/program*/
+SearchOptions::SearchOptions()
+    : num_threads(1),
+      order(kCandidateSizeOrder),
+      format(kTextOutput),
+      mode(kPrintMatches),
+      limit(Backtrack::kDefaultLimit),
+      limit_given(false),
+      dense_labels(false),
+      vertex_order(kInputOrder),
+      verify(false),
+      time_limit(0),
+      symmetry(false) {}
+
+/**
+ * @brief Parses the search option argv[i], and its value if it has one, and
+ * then moves i to the last argument it took. Throws std::invalid_argument or
+ * std::out_of_range (from std::stoul and std::stod) if a number is not valid.
+ *
+ * @param argc
+ * @param argv
+ * @param i index of the option.
+ * @param options output.
+ * @return bool false if argv[i] is not a search option, or its value is
+ * missing or unknown.
+ */
+bool ParseSearchOption(int argc, char *argv[], int &i,
+                       SearchOptions &options) {
+  std::string option = argv[i];
+  bool has_value = i + 1 < argc;
+  if (option == "--threads" && has_value) {
+    options.num_threads = std::stoul(argv[++i]);
+  } else if (option == "--order" && has_value &&
+             ParseOrderType(argv[i + 1], options.order)) {
+    ++i;
+  } else if (option == "--format" && has_value &&
+             ParseOutputFormat(argv[i + 1], options.format)) {
+    ++i;
+  } else if (option == "--mode" && has_value &&
+             ParseMatchMode(argv[i + 1], options.mode)) {
+    ++i;
+  } else if (option == "--limit" && has_value) {
+    // --limit 0 means no limit
+    options.limit = std::stoul(argv[++i]);
+    if (options.limit == 0) options.limit = Backtrack::kNoLimit;
+    options.limit_given = true;
+  } else if (option == "--dense-labels") {
+    options.dense_labels = true;
+  } else if (option == "--reorder" && has_value &&
+             ParseVertexOrder(argv[i + 1], options.vertex_order)) {
+    ++i;
+  } else if (option == "--verify") {
+    options.verify = true;
+  } else if (option == "--time-limit" && has_value) {
+    options.time_limit = std::stod(argv[++i]);
+  } else if (option == "--symmetry") {
+    options.symmetry = true;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Reads the candidate set file of a query, or filters the candidates
+ * in process if the file name is "-", and builds the DAG of the query rooted
+ * by them. Throws std::runtime_error if a file is missing or malformed.
+ *
+ * @param data
+ * @param query_file_name
+ * @param candidate_set_file_name
+ * @return PreparedQuery
+ */
+PreparedQuery PrepareQuery(const Graph &data,
+                           const std::string &query_file_name,
+                           const std::string &candidate_set_file_name) {
+  PreparedQuery prepared;
+  if (candidate_set_file_name == "-") {
+    Graph query_graph(query_file_name, true);
+    prepared.candidate_set.reset(new CandidateSet(data, query_graph));
+    // refine over a DAG rooted by the filtered candidates, then root the DAG
+    // of the search by the refined ones
+    prepared.candidate_set->Refine(
+        data, Dag(query_file_name, *prepared.candidate_set, true));
+  } else {
+    prepared.candidate_set.reset(
+        new CandidateSet(candidate_set_file_name, &data));
+  }
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  prepared.dag.reset(new Dag(query_file_name, *prepared.candidate_set, true));
+  prepared.dag_ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+  return prepared;
+}
@@ -0,0 +1,84 @@
+/**
+ * @file search_stats.cc
+ *
+ */
+
+#include "search_stats.h"
+
+#include <sstream>
+
+const bool SearchStats::kEnabled;
+
+/**
+ * @brief Sets every counter to zero, with a depth for every query vertex.
+ *
+ * @param num_query_vertices
+ */
+void SearchStats::Reset(size_t num_query_vertices) {
+  nodes_per_depth.assign(num_query_vertices, 0);
+  injectivity_conflicts = 0;
+  symmetry_conflicts = 0;
+  edge_rejections = 0;
+  intersections = 0;
+  empty_extendable = 0;
+  failing_set_prunes = 0;
+  update_extendable_calls = 0;
+  update_extendable_ns = 0;
+  first_embedding_ms = -1;
+}
+
+/**
+ * @brief Adds the counts of other, the stats of another worker of the same
+ * search.
+ *
+ * @param other
+ */
+void SearchStats::Merge(const SearchStats &other) {
+  if (nodes_per_depth.size() < other.nodes_per_depth.size())
+    nodes_per_depth.resize(other.nodes_per_depth.size(), 0);
+  for (size_t d = 0; d < other.nodes_per_depth.size(); ++d)
+    nodes_per_depth[d] += other.nodes_per_depth[d];
+  injectivity_conflicts += other.injectivity_conflicts;
+  symmetry_conflicts += other.symmetry_conflicts;
+  edge_rejections += other.edge_rejections;
+  intersections += other.intersections;
+  empty_extendable += other.empty_extendable;
+  failing_set_prunes += other.failing_set_prunes;
+  update_extendable_calls += other.update_extendable_calls;
+  update_extendable_ns += other.update_extendable_ns;
+  if (other.first_embedding_ms >= 0 &&
+      (first_embedding_ms < 0 || other.first_embedding_ms < first_embedding_ms))
+    first_embedding_ms = other.first_embedding_ms;
+}
+
+/**
+ * @brief Returns the counters as "name value" lines, and the nodes of every
+ * depth that has some.
+ *
+ * @return std::string
+ */
+std::string SearchStats::ToString() const {
+  std::ostringstream out;
+  if (!kEnabled) {
+    out << "stats disabled, build with -DENABLE_STATS=ON\n";
+    return out.str();
+  }
+
+  uint64_t nodes = 0;
+  for (uint64_t n : nodes_per_depth) nodes += n;
+  out << "nodes " << nodes << "\n";
+  out << "injectivity_conflicts " << injectivity_conflicts << "\n";
+  out << "symmetry_conflicts " << symmetry_conflicts << "\n";
+  out << "edge_rejections " << edge_rejections << "\n";
+  out << "intersections " << intersections << "\n";
+  out << "empty_extendable " << empty_extendable << "\n";
+  out << "failing_set_prunes " << failing_set_prunes << "\n";
+  out << "update_extendable_calls " << update_extendable_calls << "\n";
+  out << "update_extendable_ms " << update_extendable_ns / 1e6 << "\n";
+  out << "first_embedding_ms " << first_embedding_ms << "\n";
+  out << "nodes_per_depth";
+  for (size_t d = 0; d < nodes_per_depth.size() && nodes_per_depth[d] > 0; ++d)
+    out << " " << nodes_per_depth[d];
+  out << "\n";
+  return out.str();
+}
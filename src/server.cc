@@ -0,0 +1,370 @@
+/**
+ * @file server.cc
+ *
+ */
+
+#include "server.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#include "backtrack.h"
+
+namespace {
+
+/*bounds the # of queries matched at the same time over all clients*/
+class JobSlots {
+ public:
+  explicit JobSlots(size_t num_slots) : free_(num_slots > 0 ? num_slots : 1) {}
+
+  void Acquire() {
+    std::unique_lock<std::mutex> lock(lock_);
+    cv_.wait(lock, [this] { return free_ > 0; });
+    free_--;
+  }
+  void Release() {
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      free_++;
+    }
+    cv_.notify_one();
+  }
+
+ private:
+  std::mutex lock_;
+  std::condition_variable cv_;
+  size_t free_;
+};
+
+/*requests being answered and their searches, so that a shutdown can cancel
+the searches and wait for the answers*/
+class Shutdown {
+ public:
+  Shutdown() : stopping_(false), in_flight_(0) {}
+
+  /*false once the server is stopping, which takes no more requests*/
+  bool BeginRequest() {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (stopping_) return false;
+    in_flight_++;
+    return true;
+  }
+  void EndRequest() {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (--in_flight_ == 0) idle_cv_.notify_all();
+  }
+
+  /*a search that is started after the shutdown is cancelled at once*/
+  void AddSearch(Backtrack *search) {
+    std::lock_guard<std::mutex> guard(lock_);
+    searches_.insert(search);
+    if (stopping_) search->Cancel();
+  }
+  void RemoveSearch(Backtrack *search) {
+    std::lock_guard<std::mutex> guard(lock_);
+    searches_.erase(search);
+  }
+
+  /*cancels every search, and returns once every request is answered*/
+  void StopAndWait() {
+    std::unique_lock<std::mutex> lock(lock_);
+    stopping_ = true;
+    for (Backtrack *search : searches_) search->Cancel();
+    idle_cv_.wait(lock, [this] { return in_flight_ == 0; });
+  }
+
+ private:
+  std::mutex lock_;
+  std::condition_variable idle_cv_;
+  bool stopping_;
+  size_t in_flight_;
+  std::set<Backtrack *> searches_;
+};
+
+double Milliseconds(std::chrono::steady_clock::duration d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+/*matches one request against the shared data graph, which is only read*/
+std::string Match(const Graph &data, const std::string &request,
+                  const ServerOptions &options, Shutdown &shutdown) {
+  std::istringstream fields(request);
+  std::string query_file_name, candidate_set_file_name, output_file_name;
+  if (!(fields >> query_file_name >> candidate_set_file_name >>
+        output_file_name))
+    return "error " + request +
+           " expected <query graph file> <candidate set file> <output file>";
+
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+
+  // the loaders throw on a bad file, which only fails this request
+  PreparedQuery prepared;
+  try {
+    prepared = PrepareQuery(data, query_file_name, candidate_set_file_name);
+  } catch (const std::exception &e) {
+    return "error " + query_file_name + " " + e.what();
+  }
+  const SearchOptions &search = options.search;
+
+  std::chrono::steady_clock::time_point loaded =
+      std::chrono::steady_clock::now();
+
+  bool print = search.mode == kPrintMatches;
+  int fd = -1;
+  if (print)
+    fd = open(output_file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (print && fd < 0)
+    return "error " + query_file_name + " cannot write " + output_file_name;
+
+  // so does a search that throws
+  EmbeddingWriter out(fd, search.format);
+  std::unique_ptr<Backtrack> backtrack;
+  try {
+    backtrack.reset(new Backtrack(data, *prepared.dag, *prepared.candidate_set,
+                                  search.num_threads, &out, search.order));
+    backtrack->SetVerification(search.verify);
+    backtrack->SetTimeLimit(search.time_limit);
+    backtrack->SetSymmetryBreaking(search.symmetry);
+    shutdown.AddSearch(backtrack.get());
+    if (print)
+      backtrack->PrintAllMatches(search.limit);
+    else
+      backtrack->CountMatches(search.mode == kExistsMatch ? 1 : search.limit);
+    shutdown.RemoveSearch(backtrack.get());
+  } catch (const std::exception &e) {
+    shutdown.RemoveSearch(backtrack.get());
+    if (print) {
+      // out must not flush into the descriptor once it is closed
+      out.Flush();
+      close(fd);
+    }
+    return "error " + query_file_name + " " + e.what();
+  }
+  bool written = true;
+  if (print) {
+    written = out.Ok();
+    if (close(fd) != 0) written = false;
+  }
+
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  if (!written)
+    return "error " + query_file_name + " cannot write " + output_file_name;
+  if (backtrack->GetNumInvalidEmbeddings() > 0)
+    return "error " + query_file_name + " " +
+           std::to_string(backtrack->GetNumInvalidEmbeddings()) +
+           " embeddings failed verification";
+
+  std::ostringstream response;
+  response << "done " << query_file_name << " "
+           << backtrack->GetNumEmbeddings() << " "
+           << Milliseconds(loaded - start) << " " << Milliseconds(end - loaded);
+  if (backtrack->IsTruncated()) response << " truncated";
+  return response.str();
+}
+
+/*one client: stdin and stdout, or a socket connection. requests of a session
+run concurrently, and each answer is written when its request is finished*/
+class Session {
+ public:
+  Session(const Graph &data, const ServerOptions &options, JobSlots &slots,
+          Shutdown &shutdown, int out_fd)
+      : data_(data), options_(options), slots_(slots), shutdown_(shutdown),
+        out_fd_(out_fd), running_(0) {}
+
+  /*reads requests until the end of in, and waits for all of their answers*/
+  void Run(FILE *in) {
+    char *line = nullptr;
+    size_t capacity = 0;
+    ssize_t length;
+    while ((length = getline(&line, &capacity, in)) != -1) {
+      std::string request(line, length);
+      while (!request.empty() && isspace(request.back())) request.pop_back();
+      if (request.empty()) continue;
+      if (!shutdown_.BeginRequest()) break;
+
+      slots_.Acquire();
+      {
+        std::lock_guard<std::mutex> guard(lock_);
+        running_++;
+      }
+      std::thread(&Session::Serve, this, request).detach();
+    }
+    free(line);
+
+    std::unique_lock<std::mutex> lock(lock_);
+    done_cv_.wait(lock, [this] { return running_ == 0; });
+  }
+
+ private:
+  void Serve(std::string request) {
+    std::string response = Match(data_, request, options_, shutdown_) + "\n";
+    slots_.Release();
+
+    std::lock_guard<std::mutex> guard(lock_);
+    const char *p = response.data();
+    size_t size = response.size();
+    while (size > 0) {
+      ssize_t written = write(out_fd_, p, size);
+      if (written <= 0) break;  // the client is gone
+      p += written;
+      size -= written;
+    }
+    shutdown_.EndRequest();
+    if (--running_ == 0) done_cv_.notify_all();
+  }
+
+  const Graph &data_;
+  const ServerOptions &options_;
+  JobSlots &slots_;
+  Shutdown &shutdown_;
+  int out_fd_;
+
+  std::mutex lock_;
+  std::condition_variable done_cv_;
+  size_t running_;
+};
+
+/*open connections of the socket, so that the server can end them and wait for
+their sessions before it returns*/
+class Connections {
+ public:
+  void Add(int fd) {
+    std::lock_guard<std::mutex> guard(lock_);
+    fds_.insert(fd);
+  }
+  /*closes in, the connection fd, once its session is finished*/
+  void Close(int fd, FILE *in) {
+    std::lock_guard<std::mutex> guard(lock_);
+    fds_.erase(fd);
+    fclose(in);
+    if (fds_.empty()) closed_cv_.notify_all();
+  }
+
+  /*ends the input of every connection, so that its session stops reading and
+  answers the requests it took, and returns once every connection is closed*/
+  void EndAndWait() {
+    std::unique_lock<std::mutex> lock(lock_);
+    for (int fd : fds_) shutdown(fd, SHUT_RD);
+    closed_cv_.wait(lock, [this] { return fds_.empty(); });
+  }
+
+ private:
+  std::mutex lock_;
+  std::condition_variable closed_cv_;
+  std::set<int> fds_;
+};
+
+int ListenSocket(const std::string &path) {
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "Socket path " << path << " is too long\n";
+    return -1;
+  }
+  std::strcpy(addr.sun_path, path.c_str());
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    perror("socket");
+    return -1;
+  }
+  unlink(path.c_str());
+  if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      listen(fd, 16) != 0) {
+    perror(path.c_str());
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+}  // namespace
+
+/**
+ * @brief Answers requests (see server.h) from stdin, or from every client of
+ * a UNIX socket, until the input ends or SIGTERM or SIGINT arrives. The data
+ * graph is loaded once by the caller and shared by all queries.
+ *
+ * @param data
+ * @param options
+ * @return int exit status.
+ */
+int RunServer(const Graph &data, const ServerOptions &options) {
+  JobSlots slots(options.num_jobs);
+
+  // SIGTERM and SIGINT are taken by a thread of their own, blocked in every
+  // other thread: it cancels the running searches, which answer with the
+  // embeddings found so far, and exits once they are answered
+  std::shared_ptr<Shutdown> shutdown = std::make_shared<Shutdown>();
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGTERM);
+  sigaddset(&signals, SIGINT);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+  std::string socket_path = options.socket_path;
+  std::thread([shutdown, signals, socket_path]() {
+    int signal_number;
+    sigwait(&signals, &signal_number);
+    shutdown->StopAndWait();
+    if (!socket_path.empty()) unlink(socket_path.c_str());
+    // the answers are written with write(2), so nothing is left to flush
+    _exit(EXIT_SUCCESS);
+  }).detach();
+
+  if (options.socket_path.empty()) {
+    Session session(data, options, slots, *shutdown, STDOUT_FILENO);
+    session.Run(stdin);
+    return EXIT_SUCCESS;
+  }
+
+  int listen_fd = ListenSocket(options.socket_path);
+  if (listen_fd < 0) return EXIT_FAILURE;
+
+  // a client that disconnects early must not kill the server
+  signal(SIGPIPE, SIG_IGN);
+  std::cerr << "Listening on " << options.socket_path << "\n";
+
+  // the sessions use data, options and slots of this frame, so the server
+  // waits for them before it returns
+  Connections connections;
+  while (true) {
+    int conn = accept(listen_fd, nullptr, nullptr);
+    if (conn < 0) {
+      // a client that gave up before it was accepted is not an error
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      perror("accept");
+      break;
+    }
+    connections.Add(conn);
+    std::thread([&data, &options, &slots, &connections, shutdown, conn]() {
+      FILE *in = fdopen(conn, "r");
+      {
+        Session session(data, options, slots, *shutdown, conn);
+        session.Run(in);
+      }
+      connections.Close(conn, in);
+    }).detach();
+  }
+
+  close(listen_fd);
+  connections.EndAndWait();
+  unlink(options.socket_path.c_str());
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file work_stealing_pool.cc
+ *
+ */
+
+#include "work_stealing_pool.h"
+
+#include <chrono>
+#include <thread>
+
+WorkStealingPool::WorkStealingPool(size_t num_workers)
+    : pending_(0), queued_(0), idle_(0), stopped_(false) {
+  if (num_workers == 0) num_workers = 1;
+  for (size_t i = 0; i < num_workers; ++i)
+    queues_.push_back(std::unique_ptr<TaskQueue>(new TaskQueue()));
+}
+
+WorkStealingPool::~WorkStealingPool() {}
+
+/**
+ * @brief Pushes a task to the back of the queue owned by the worker.
+ *
+ * @param worker id of the pushing worker.
+ * @param task
+ */
+void WorkStealingPool::Push(size_t worker, SearchTask &&task) {
+  pending_++;
+  {
+    std::lock_guard<std::mutex> guard(queues_[worker]->lock);
+    queues_[worker]->tasks.push_back(std::move(task));
+  }
+  queued_++;
+  wait_cv_.notify_one();
+}
+
+/**
+ * @brief Runs run_task on every task (including the ones pushed while
+ * running) with GetNumWorkers() threads. The calling thread is worker 0.
+ * Returns when every task is finished or the pool is stopped.
+ *
+ * @param run_task callback taking (worker id, task).
+ */
+void WorkStealingPool::Run(
+    const std::function<void(size_t, SearchTask &)> &run_task) {
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < queues_.size(); ++i)
+    threads.push_back(std::thread(&WorkStealingPool::WorkerLoop, this, i,
+                                  std::cref(run_task)));
+  WorkerLoop(0, run_task);
+  for (std::thread &t : threads) t.join();
+}
+
+void WorkStealingPool::Stop() {
+  stopped_ = true;
+  wait_cv_.notify_all();
+}
+
+/*own queue is used as a stack (depth first, good locality), while the
+oldest task of the other queues, usually the largest subtree, is stolen*/
+bool WorkStealingPool::Take(size_t worker, SearchTask &task) {
+  {
+    TaskQueue &own = *queues_[worker];
+    std::lock_guard<std::mutex> guard(own.lock);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      queued_--;
+      return true;
+    }
+  }
+  for (size_t i = 1; i < queues_.size(); ++i) {
+    TaskQueue &victim = *queues_[(worker + i) % queues_.size()];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      queued_--;
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingPool::WorkerLoop(
+    size_t worker, const std::function<void(size_t, SearchTask &)> &run_task) {
+  SearchTask task;
+  while (!IsStopped()) {
+    if (Take(worker, task)) {
+      run_task(worker, task);
+      if (--pending_ == 0) wait_cv_.notify_all();
+      continue;
+    }
+    if (pending_ == 0) break;
+
+    /*nothing to steal right now: running workers split their subtree
+    when they see an idle worker*/
+    idle_++;
+    {
+      std::unique_lock<std::mutex> lock(wait_lock_);
+      wait_cv_.wait_for(lock, std::chrono::milliseconds(1));
+    }
+    idle_--;
+  }
+}